@@ -14,6 +14,7 @@
 #include <iostream>
 #include <cassert>
 #include <queue>
+#include <list>
 #include <vector>
 #include <string>
 #include <iterator>
@@ -21,9 +22,243 @@
 #include <memory_resource>
 #include <initializer_list>
 #include <functional>
+#include <compare>
+#include <type_traits>
+#include <cstdint>
+#include <algorithm>
+#include <future>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <system_error>
+#include <fstream>
+#include <cstring>
+#include <cmath>
+
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+	#include <xmmintrin.h>
+#endif
+
+//  Трёхпутевое сравнение ключей: отрицательное значение – a < b, ноль – a и b эквивалентны, положительное – a > b.
+//  Спуск по дереву с таким сравнением делает одно сравнение на уровень вместо двух вызовов cmp(a,b) и cmp(b,a),
+//    что заметно для «дорогих» ключей (длинных строк и т.п.).
+//  Компаратор может предоставить метод compare3(a, b), возвращающий int или std::*_ordering. Для std::less и std::greater
+//    над типами с operator<=> используется он, для остальных компараторов – переходник через два вызова cmp.
+//  Шаблон можно специализировать для своих компараторов
+template<typename T, class Compare, class = void>
+struct Three_Way_Compare
+{
+	static int compare(const Compare& cmp, const T& a, const T& b)
+	{
+		if (cmp(a, b)) return -1;
+		return cmp(b, a) ? 1 : 0;
+	}
+};
+
+template<typename T, class Compare>
+struct Three_Way_Compare<T, Compare, std::void_t<decltype(std::declval<const Compare&>().compare3(std::declval<const T&>(), std::declval<const T&>()))>>
+{
+	static int compare(const Compare& cmp, const T& a, const T& b)
+	{
+		auto result = cmp.compare3(a, b);
+		return result < 0 ? -1 : (result > 0 ? 1 : 0);
+	}
+};
+
+template<typename T>
+struct Three_Way_Compare<T, std::less<T>, std::enable_if_t<std::three_way_comparable<T>>>
+{
+	static int compare(const std::less<T>&, const T& a, const T& b)
+	{
+		auto result = a <=> b;
+		return result < 0 ? -1 : (result > 0 ? 1 : 0);
+	}
+};
+
+template<typename T>
+struct Three_Way_Compare<T, std::less<>, std::enable_if_t<std::three_way_comparable<T>>>
+{
+	static int compare(const std::less<>&, const T& a, const T& b)
+	{
+		return Three_Way_Compare<T, std::less<T>>::compare(std::less<T>(), a, b);
+	}
+};
+
+template<typename T>
+struct Three_Way_Compare<T, std::greater<T>, std::enable_if_t<std::three_way_comparable<T>>>
+{
+	static int compare(const std::greater<T>&, const T& a, const T& b)
+	{
+		auto result = b <=> a;
+		return result < 0 ? -1 : (result > 0 ? 1 : 0);
+	}
+};
+
+//  Префикс ключа, хранимый прямо в узле рядом с указателями. При спуске сначала сравниваются префиксы,
+//    а сам ключ (например, буфер строки в куче) читается только при их совпадении – минус один промах кэша на уровень.
+//  Префикс обязан быть согласован с компаратором: если prefix(a) < prefix(b), то cmp(a, b) == true.
+//  По умолчанию префикс не хранится; шаблон можно специализировать для своих ключей
+template<typename T, class Compare, class = void>
+struct Key_Prefix_Traits
+{
+	static constexpr bool enabled = false;
+	struct prefix_type {};
+	static prefix_type make(const T&) noexcept { return prefix_type(); }
+};
+
+//  Для строк с лексикографическим порядком префикс – первые 8 байт, упакованные в число старшими байтами вперёд.
+//    Строки сравниваются как последовательности unsigned char, поэтому порядок чисел совпадает с порядком строк,
+//    а короткие строки дополняются нулями (при равенстве префиксов сравниваются целые строки)
+template<class Compare>
+struct Key_Prefix_Traits<std::string, Compare, std::enable_if_t<std::is_same_v<Compare, std::less<std::string>> || std::is_same_v<Compare, std::less<>>>>
+{
+	static constexpr bool enabled = true;
+	using prefix_type = std::uint64_t;
+	static prefix_type make(const std::string& key) noexcept
+	{
+		prefix_type prefix = 0;
+		for (size_t i = 0; i < sizeof(prefix_type); ++i)
+			prefix = (prefix << 8) | (i < key.size() ? static_cast<unsigned char>(key[i]) : 0u);
+		return prefix;
+	}
+};
 
-template<typename T, class Compare = std::less<T>, class Allocator = std::allocator<T>>
-class Binary_Search_Tree
+//  Поле префикса в узле. Узел наследуется от него, поэтому без префикса узел не увеличивается
+template<class Traits, bool = Traits::enabled>
+struct Node_Key_Prefix {};
+
+template<class Traits>
+struct Node_Key_Prefix<Traits, true>
+{
+	typename Traits::prefix_type prefix;
+};
+
+//  Заголовок двоичного снимка дерева (файл, записываемый Binary_Search_Tree::save). Формат:
+//    [0, 64)            – заголовок (поля ниже, остаток заполнен нулями)
+//    [64, 64 + n*size)  – ключи в порядке возрастания, побайтовые копии T
+//    далее (если установлен флаг has_shape) – форма дерева: по 2 бита на узел в прямом порядке обхода
+//      (бит 0 – есть левое поддерево, бит 1 – есть правое), 4 узла в байте начиная с младших битов
+//  Числа записываются в порядке байтов платформы, поэтому снимок переносим только между одинаковыми платформами
+struct Tree_Snapshot_Header
+{
+	static constexpr char signature[4] = { 'B', 'S', 'T', 'S' };
+	static constexpr std::uint32_t current_version = 1;
+	static constexpr std::uint32_t has_shape = 1;
+	static constexpr std::uint64_t keys_offset = 64;
+
+	char magic[4];
+	std::uint32_t version;
+	std::uint32_t key_size;
+	std::uint32_t flags;
+	std::uint64_t count;
+
+	//  Проверка заголовка для ключей размера key_bytes
+	bool valid(std::uint32_t key_bytes) const noexcept
+	{
+		return std::memcmp(magic, signature, sizeof(magic)) == 0 && version == current_version && key_size == key_bytes;
+	}
+};
+
+//  Политика сбора статистики – последний параметр шаблона дерева. Дерево вызывает методы политики
+//    в характерных местах: при каждом сравнении ключей (трёхпутевое сравнение считается одним), в начале спуска
+//    по ключу (insert, find, lower_bound, upper_bound, equal_range) и на каждом пройденном при этом узле,
+//    при выделении и освобождении узлов и при перевязке узлов (перестройка при слиянии, разрезание и склейка
+//    при удалении диапазона, перестановка узла при удалении). Методы константные: счётчики обновляются и
+//    при поиске в константном дереве.
+//  По умолчанию – No_Tree_Stats: методы пустые, а пустой базовый класс не увеличивает размер дерева,
+//    так что без статистики не тратится ни времени, ни памяти. Свою политику можно сделать по образцу
+//    Tree_Stats, например, для передачи счётчиков в систему мониторинга.
+struct No_Tree_Stats
+{
+	static constexpr bool enabled = false;
+	void compared() const noexcept {}
+	void lookup() const noexcept {}
+	void visited() const noexcept {}
+	void allocated(size_t = 1) const noexcept {}
+	void freed(size_t = 1) const noexcept {}
+	void relinked(size_t = 1) const noexcept {}
+};
+
+//  Простые счётчики. Дерево не потокобезопасно, поэтому счётчики обычные, не атомарные: узлы, созданные
+//    или удалённые в параллельных частях копирования, построения и удаления, учитываются одним вызовом после них
+struct Tree_Stats
+{
+	static constexpr bool enabled = true;
+	mutable std::uint64_t comparisons = 0;
+	mutable std::uint64_t lookups = 0;
+	mutable std::uint64_t visits = 0;
+	mutable std::uint64_t allocations = 0;
+	mutable std::uint64_t frees = 0;
+	mutable std::uint64_t relinks = 0;
+
+	void compared() const noexcept { ++comparisons; }
+	void lookup() const noexcept { ++lookups; }
+	void visited() const noexcept { ++visits; }
+	void allocated(size_t count = 1) const noexcept { allocations += count; }
+	void freed(size_t count = 1) const noexcept { frees += count; }
+	void relinked(size_t count = 1) const noexcept { relinks += count; }
+
+	//  Среднее число узлов, пройденных за один спуск
+	double visits_per_lookup() const noexcept { return lookups ? static_cast<double>(visits) / lookups : 0.0; }
+};
+
+//  Политика дополнения узлов (augmentation) – пятый параметр шаблона дерева. Включённая политика хранит в каждом
+//    узле значение value_type, зависящее только от ключа узла и значений его дочерних, например, максимум концов
+//    интервалов в поддереве (IntervalTree.h). Дерево пересчитывает значения при каждом изменении формы:
+//    на пути от изменённого места к корню при вставке, удалении, перестановке узлов и разрезании/склейке,
+//    снизу вверх при построении и перестройке. Политика должна предоставить
+//      static constexpr bool enabled = true;
+//      using value_type = ...;        //  конструктор по умолчанию не должен бросать исключений
+//      static void update(const Compare& cmp, value_type& value, const T& key, const value_type* left, const value_type* right);
+//    где left и right – значения дочерних узлов или nullptr, если дочернего нет.
+//  По умолчанию – No_Tree_Augment: в узлах ничего не хранится и ничего не пересчитывается
+struct No_Tree_Augment
+{
+	static constexpr bool enabled = false;
+};
+
+template<class Augment, bool = Augment::enabled>
+struct Node_Augment {};
+
+template<class Augment>
+struct Node_Augment<Augment, true>
+{
+	static_assert(std::is_nothrow_default_constructible_v<typename Augment::value_type>,
+		"augmented values must be nothrow default constructible");
+	typename Augment::value_type augment;
+};
+
+//  Подсказка процессору: скоро понадобится память по адресу address (загрузка в кэш без ожидания).
+//    Адрес может быть любым, в том числе фиктивной вершиной – ошибки обращения при предвыборке не бывает
+inline void prefetch_for_read(const void* address) noexcept
+{
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+	_mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#elif defined(__GNUC__) || defined(__clang__)
+	__builtin_prefetch(address);
+#else
+	(void)address;
+#endif
+}
+
+//  Форма дерева: высота (число уровней), средняя глубина узла (у корня 0) и количество узлов на каждой глубине
+struct Tree_Shape_Stats
+{
+	size_t height = 0;
+	double average_depth = 0;
+	std::vector<size_t> depth_histogram;
+};
+
+//  Результат перестройки дерева на месте (Binary_Search_Tree::rebalance)
+struct Tree_Rebalance_Stats
+{
+	size_t height_before = 0;
+	size_t height_after = 0;
+};
+
+template<typename T, class Compare = std::less<T>, class Allocator = std::allocator<T>, class Stats = No_Tree_Stats,
+	class Augment = No_Tree_Augment>
+class Binary_Search_Tree : private Stats
 {
 	//  Объект для сравнения ключей. Должен удовлетворять требованию строго слабого порядка, т.е. иметь свойства:
 	//    1. Для любого x => cmp(x,x) == false (антирефлексивность)
@@ -34,8 +269,27 @@ class Binary_Search_Tree
 	//     нужными свойствами, то можно использовать его отрицание и рассматривать дерево как инвертированное от требуемого.
 	Compare cmp = Compare();
 
-	//  Узел бинарного дерева, хранит ключ, три указателя и признак nil для обозначения фиктивной вершины
-	class Node
+	//  Одно трёхпутевое сравнение вместо пары cmp(a,b), cmp(b,a) – используется при спусках по дереву
+	inline int compare3(const T& a, const T& b) const
+	{
+		stats().compared();
+		return Three_Way_Compare<T, Compare>::compare(cmp, a, b);
+	}
+
+	inline bool less(const T& a, const T& b) const
+	{
+		stats().compared();
+		return cmp(a, b);
+	}
+
+	using Prefix = Key_Prefix_Traits<T, Compare>;
+	using key_prefix = typename Prefix::prefix_type;
+
+protected:
+	//  Узел бинарного дерева, хранит ключ, три указателя и признак nil для обозначения фиктивной вершины.
+	//    Если для ключа включён префикс (Key_Prefix_Traits) или политика дополнения (Augment), то они хранятся
+	//    в базовых частях узла. Узел доступен производным контейнерам (например, дереву интервалов)
+	class Node : public Node_Key_Prefix<Prefix>, public Node_Augment<Augment>
 	{
 	public:  //  Все поля открыты (public), т.к. само определение узла спрятано в private-части дерева
 		Node* parent;
@@ -48,6 +302,8 @@ class Binary_Search_Tree
 		Node(T value = T(), Node* p = nullptr, Node* l = nullptr, Node* r = nullptr) : parent(p), data(value), left(l), right(r) {}
 	};
 
+private:
+
 	//  Стандартные контейнеры позволяют указать пользовательский аллокатор, который используется для
 	//  выделения и освобождения памяти под узлы (реализует замену операций new/delete). К сожалению, есть 
 	//  типичная проблема – при создании дерева с ключами типа T параметром шаблона традиционно указывается
@@ -56,6 +312,34 @@ class Binary_Search_Tree
 	//  с T на Node, что и делается ниже. А вообще это одна из самых малополезных возможностей - обычно мы
 	//  пользовательские аллокаторы не пишем, это редкость.
 
+	//  Сравнения искомого ключа (с заранее вычисленным префиксом) с ключом в узле. Если префиксы различны,
+	//    то результат известен без обращения к самому ключу
+	inline int compare3(const T& key, const key_prefix& kp, const Node* node) const
+	{
+		stats().visited();
+		if constexpr (Prefix::enabled)
+			if (kp != node->prefix) return kp < node->prefix ? -1 : 1;
+		return compare3(key, node->data);
+	}
+
+	//  key < ключа узла
+	inline bool less(const T& key, const key_prefix& kp, const Node* node) const
+	{
+		stats().visited();
+		if constexpr (Prefix::enabled)
+			if (kp != node->prefix) return kp < node->prefix;
+		return less(key, node->data);
+	}
+
+	//  ключ узла < key
+	inline bool less(const Node* node, const T& key, const key_prefix& kp) const
+	{
+		stats().visited();
+		if constexpr (Prefix::enabled)
+			if (kp != node->prefix) return node->prefix < kp;
+		return less(node->data, key);
+	}
+
 	//  Определяем тип аллокатора для Node (Allocator нам не подходит)
 	using AllocType = typename std::allocator_traits<Allocator>::template rebind_alloc < Node >;
 	//  Аллокатор для выделения памяти под объекты Node
@@ -77,12 +361,12 @@ public:
 	using key_type = T;
 	using key_compare = Compare;
 	using value_compare = Compare;
-	using value_type = typename T;
-	using allocator_type = typename AllocType;
-	using size_type = typename size_t;
-	using difference_type = typename size_t;
-	using pointer = typename T *;
-	using const_pointer = typename const pointer;
+	using value_type = T;
+	using allocator_type = Allocator;
+	using size_type = size_t;
+	using difference_type = size_t;
+	using pointer = T *;
+	using const_pointer = const T *;
 	using reference = value_type & ;
 	using const_reference = const value_type &;
 	//using iterator = typename _Mybase::iterator;   //  Не нужно! Явно определили iterator внутри данного класса
@@ -91,18 +375,52 @@ public:
 	using reverse_iterator = std::reverse_iterator<iterator>;
 	using const_reverse_iterator = std::reverse_iterator<const_iterator>;
 
-private:
+protected:
 	// Указательно на фиктивную вершину
 	Node* dummy;
 
+private:
 	//  Количесто элементов в дереве
-	size_type tree_size = 0;
+	mutable size_type tree_size = 0;
+
+	//  Удаления erase_deferred, узлы которых ещё пересчитываются и освобождаются в фоновых потоках. Число удалённых
+	//    элементов становится известно только там, поэтому оно вычитается из tree_size при первом обращении
+	//    к размеру (settle_deferred). Пока таких удалений не было, указатель пуст и ничего не стоит
+	struct Deferred_Erase
+	{
+		std::mutex lock;
+		std::vector<std::shared_future<size_type>> pending;
+	};
+	std::unique_ptr<Deferred_Erase> deferred;
+
+	//  Учёт в размере удалений erase_deferred: ждёт, пока фоновые потоки пересчитают отрезанные узлы.
+	//    Вызывается перед каждым чтением tree_size, кроме изменений на ±1, которые от порядка не зависят
+	void settle_deferred() const
+	{
+		if (!deferred) return;
+		std::lock_guard<std::mutex> guard(deferred->lock);
+		for (std::shared_future<size_type>& count : deferred->pending) {
+			size_type freed = count.get();
+			tree_size -= freed;
+			stats().freed(freed);
+		}
+		deferred->pending.clear();
+	}
+
+	//  Забыть незавершённые удаления, когда tree_size задаётся заново (очистка, построение). Фоновые потоки
+	//    отсоединены, их узлы уже не принадлежат дереву – ждать их не нужно
+	void drop_deferred() noexcept
+	{
+		if (!deferred) return;
+		std::lock_guard<std::mutex> guard(deferred->lock);
+		deferred->pending.clear();
+	}
 
 	// Создание фиктивной вершины - используется только при создании дерева
 	inline Node* make_dummy()
 	{
 		// Выделяем память по размеру узла без конструирования
-		dummy = Alc.allocate(1);
+		dummy = std::allocator_traits<AllocType>::allocate(Alc, 1);
 		
 		//  Все поля, являющиеся указателями на узлы (left, right, parent) инициализируем и обнуляем
 		std::allocator_traits<AllocType>::construct(Alc, &(dummy->parent));
@@ -121,24 +439,52 @@ private:
 	}
 
 	// Создание узла дерева 
-	inline Node* make_node(const value_type & elem, Node * parent, Node* left, Node* right)
+	template<class Value>
+	inline Node* make_node(Value && elem, Node * parent, Node* left, Node* right)
+	{
+		stats().allocated();
+		return make_node(Alc, std::forward<Value>(elem), parent, left, right);
+	}
+
+	// Создание узла дерева с помощью заданного аллокатора. Нужно при параллельном копировании,
+	//   где каждый поток выделяет память через собственную копию аллокатора
+	template<class Value>
+	static Node* make_node(AllocType & alc, Value && elem, Node * parent, Node* left, Node* right)
+	{
+		return emplace_node(alc, parent, left, right, std::forward<Value>(elem));
+	}
+
+	// Создание узла с ключом, сконструированным на месте из args
+	template<class... Args>
+	static Node* emplace_node(AllocType & alc, Node * parent, Node* left, Node* right, Args&&... args)
 	{
 		// Создаём точно так же, как и фиктивную вершину, только для поля данных нужно вызвать конструктор
-		Node * new_node = Alc.allocate(1);
+		Node * new_node = std::allocator_traits<AllocType>::allocate(alc, 1);
 		
 		//  Все поля, являющиеся указателями на узлы (left, right, parent) инициализируем и обнуляем
-		std::allocator_traits<AllocType>::construct(Alc, &(new_node->parent));
+		std::allocator_traits<AllocType>::construct(alc, &(new_node->parent));
 		new_node->parent = parent;
 
-		std::allocator_traits<AllocType>::construct(Alc, &(new_node->left));
+		std::allocator_traits<AllocType>::construct(alc, &(new_node->left));
 		new_node->left = left;
 
-		std::allocator_traits<AllocType>::construct(Alc, &(new_node->right));
+		std::allocator_traits<AllocType>::construct(alc, &(new_node->right));
 		new_node->right = right;
 
-		//  Конструируем поле данных
-		std::allocator_traits<AllocType>::construct(Alc, &(new_node->data));
-		new_node->data = elem;
+		//  Конструируем поле данных сразу из значения. Конструирование идёт через аллокатор, поэтому для
+		//    std::pmr::polymorphic_allocator и std::scoped_allocator_adaptor ключ получает аллокатор дерева
+		//    (uses-allocator construction) – например, строки pmr::string размещаются в том же ресурсе, что и узлы
+		try {
+			std::allocator_traits<AllocType>::construct(alc, &(new_node->data), std::forward<Args>(args)...);
+		}
+		catch (...) {
+			delete_dummy(alc, new_node);
+			throw;
+		}
+		if constexpr (Prefix::enabled)
+			new_node->prefix = Prefix::make(new_node->data);
+		if constexpr (Augment::enabled)
+			std::allocator_traits<AllocType>::construct(alc, &(new_node->augment));
 		
 		new_node->isNil = false;
 
@@ -149,17 +495,75 @@ private:
 
 	// Удаление фиктивной вершины
 	inline void delete_dummy(Node* node) {
-		std::allocator_traits<AllocType>::destroy(Alc, &(node->parent));
-		std::allocator_traits<AllocType>::destroy(Alc, &(node->left));
-		std::allocator_traits<AllocType>::destroy(Alc, &(node->right));
-		std::allocator_traits<AllocType>::deallocate(Alc, node, 1);
+		delete_dummy(Alc, node);
+	}
+
+	static void delete_dummy(AllocType & alc, Node* node) {
+		std::allocator_traits<AllocType>::destroy(alc, &(node->parent));
+		std::allocator_traits<AllocType>::destroy(alc, &(node->left));
+		std::allocator_traits<AllocType>::destroy(alc, &(node->right));
+		std::allocator_traits<AllocType>::deallocate(alc, node, 1);
 	}
 	
 	// Удаление вершины дерева
 	inline void delete_node(Node * node) {
+		stats().freed();
+		delete_node(Alc, node);
+	}
+
+	static void delete_node(AllocType & alc, Node * node) {
 		//  Тут удаляем поле данных (вызывается деструктор), а остальное удаляем так же, как и фиктивную
-		std::allocator_traits<AllocType>::destroy(Alc, &(node->data));
-		delete_dummy(node);
+		std::allocator_traits<AllocType>::destroy(alc, &(node->data));
+		if constexpr (Augment::enabled)
+			std::allocator_traits<AllocType>::destroy(alc, &(node->augment));
+		delete_dummy(alc, node);
+	}
+
+protected:
+	//  Пересчёт дополнения узла по его ключу и дополнениям дочерних
+	void augment_node(Node* node) const
+	{
+		if constexpr (Augment::enabled)
+			Augment::update(cmp, node->augment, node->data,
+				node->left != dummy ? &node->left->augment : nullptr,
+				node->right != dummy ? &node->right->augment : nullptr);
+	}
+
+	//  Пересчёт дополнений от узла до корня – после изменения формы дерева ниже node (node может быть фиктивной)
+	void augment_path(Node* node) const
+	{
+		if constexpr (Augment::enabled)
+			for (; node != dummy; node = node->parent)
+				augment_node(node);
+	}
+
+	//  Пересчёт дополнений всего дерева снизу вверх: обратный обход по ссылкам на родителей, узел
+	//    пересчитывается, когда обход возвращается к нему из последнего дочернего
+	void augment_all() const
+	{
+		if constexpr (Augment::enabled) {
+			const Node* from = dummy;
+			Node* node = dummy->parent;
+			while (node != dummy) {
+				Node* next;
+				if (from == node->parent && node->left != dummy)
+					next = node->left;
+				else if (from != node->right && node->right != dummy)
+					next = node->right;
+				else {
+					augment_node(node);
+					next = node->parent;
+				}
+				from = node;
+				node = next;
+			}
+		}
+	}
+
+	static void copy_augment(Node* to, const Node* from)
+	{
+		if constexpr (Augment::enabled)
+			to->augment = from->augment;
 	}
 
 public:
@@ -247,12 +651,20 @@ public:
 		using pointer = Binary_Search_Tree::pointer;
 		using reference = Binary_Search_Tree::reference;
 
+		//  Итератор по умолчанию ни на что не указывает (как и у стандартных контейнеров)
+		iterator() noexcept : data(nullptr) {}
+
 		//  Значение в узле, на который указывает итератор
 		inline const T& operator*() const
 		{
 			return data->data;
 		}
 
+		inline const T* operator->() const
+		{
+			return &data->data;
+		}
+
 		//  Преинкремент - следующий элемент множества
 		iterator & operator++()
 		{
@@ -334,81 +746,194 @@ public:
 	iterator begin() const noexcept { return iterator(dummy->left);	}
 	iterator end() const noexcept { return iterator(dummy);  }
 
-	reverse_iterator rbegin() const	noexcept { return reverse_iterator(iterator(dummy->right)); }
-	reverse_iterator rend() const noexcept { return reverse_iterator(iterator(dummy)); }
+	reverse_iterator rbegin() const	noexcept { return reverse_iterator(iterator(dummy)); }
+	reverse_iterator rend() const noexcept { return reverse_iterator(iterator(dummy->left)); }
 
-	Binary_Search_Tree(Compare comparator = Compare(), AllocType alloc = AllocType())
-		: dummy(make_dummy()), cmp(comparator), Alc(alloc) {}
+	Binary_Search_Tree(const Compare& comparator = Compare(), const Allocator& alloc = Allocator())
+		: cmp(comparator), Alc(alloc), dummy(make_dummy()) {}
 
-	Binary_Search_Tree(std::initializer_list<T> il) : dummy(make_dummy())
+	explicit Binary_Search_Tree(const Allocator& alloc)
+		: Alc(alloc), dummy(make_dummy()) {}
+
+	Binary_Search_Tree(std::initializer_list<T> il, const Compare& comparator = Compare(), const Allocator& alloc = Allocator())
+		: cmp(comparator), Alc(alloc), dummy(make_dummy())
 	{
 		for (const auto &x : il)
 			insert(x);
 	}
 
-	AllocType get_allocator() const noexcept { return Alc; }
+	Binary_Search_Tree(std::initializer_list<T> il, const Allocator& alloc)
+		: Binary_Search_Tree(il, Compare(), alloc) {}
+
+	//  Аллокатор хранится перепривязанным к Node, наружу отдаётся в исходном виде
+	allocator_type get_allocator() const noexcept { return allocator_type(Alc); }
 	key_compare key_comp() const noexcept { return cmp; }
 	value_compare value_comp() const noexcept { return cmp; }
 
-	inline bool empty() const noexcept { return tree_size == 0; }
+	//  Накопленная статистика (см. No_Tree_Stats) и её сброс
+	const Stats& stats() const noexcept { return *this; }
+	void reset_stats() { static_cast<Stats&>(*this) = Stats(); }
 
-private:
-	template <class RandomIterator>
-	void ordered_insert(RandomIterator first, RandomIterator last, iterator position) {
-		if (first >= last) return;
-		RandomIterator center = first + (last - first)/2 ;
-		iterator new_pos = insert(position, *center);  //  итератор на вставленный элемент
-		ordered_insert(first, center, position);
-		ordered_insert(center + 1, last, ++position);
-	}
+	//  По форме дерева, а не по tree_size, – не ждёт фоновых удалений
+	inline bool empty() const noexcept { return dummy->parent == dummy; }
 
 public:
 	template <class InputIterator>
-	Binary_Search_Tree(InputIterator first, InputIterator last, Compare comparator = Compare(), AllocType alloc = AllocType()) : dummy(make_dummy()), cmp(comparator), Alc(alloc)
+	Binary_Search_Tree(InputIterator first, InputIterator last, const Compare& comparator = Compare(), const Allocator& alloc = Allocator())
+		: cmp(comparator), Alc(alloc), dummy(make_dummy())
 	{
-		//  Проверка на этапе компиляции - какой вид итераторов нам подали на вход
-		if (std::is_same<typename std::iterator_traits<InputIterator>::iterator_category, typename std::random_access_iterator_tag>::value) {
-			//  Если итератор произвольного доступа, то есть надежда, что диапазон отсортирован
-			//    а даже если и нет - не важно, всё равно попробуем метод деления пополам для вставки
-			ordered_insert(first, last, end());
+		//  Диапазон может быть любым – и по виду итераторов, и по порядку элементов. Поэтому копируем ключи,
+		//    сортируем с удалением повторов (для больших массивов – параллельно) и строим идеально
+		//    сбалансированное дерево за O(n), не выполняя ни одного спуска от корня
+		try {
+			std::vector<T> keys(first, last);
+			sort_unique(keys);
+			build_from_sorted(keys.data(), keys.data() + keys.size());
 		}
+		catch (...) {
+			delete_dummy(dummy);
+			throw;
+		}
+	}
+
+	template <class InputIterator>
+	Binary_Search_Tree(InputIterator first, InputIterator last, const Allocator& alloc)
+		: Binary_Search_Tree(first, last, Compare(), alloc) {}
+
+	//  Копия получает аллокатор, который выбирает сам аллокатор (select_on_container_copy_construction):
+	//    для std::allocator – такой же, для pmr – ресурс по умолчанию, а не ресурс исходного дерева
+	Binary_Search_Tree(const Binary_Search_Tree & tree)
+		: cmp(tree.cmp), Alc(alloc_traits::select_on_container_copy_construction(tree.Alc)), dummy(make_dummy())
+	{
+		construct_copy(tree);
+	}
+
+	Binary_Search_Tree(const Binary_Search_Tree & tree, const Allocator& alloc)
+		: cmp(tree.cmp), Alc(alloc), dummy(make_dummy())
+	{
+		construct_copy(tree);
+	}
+
+	//  Перемещение забирает узлы вместе с аллокатором. Исходному дереву остаётся новая пустая фиктивная вершина,
+	//    выделенная равным аллокатором, так что оно остаётся пригодным к использованию
+	Binary_Search_Tree(Binary_Search_Tree && tree)
+		: cmp(tree.cmp), Alc(std::move(tree.Alc)), dummy(make_dummy())
+	{
+		take_nodes(tree);
+	}
+
+	//  Перемещение с другим аллокатором: при равных аллокаторах узлы забираются, иначе копируются
+	//    в память нового аллокатора (узлы чужого аллокатора не могут принадлежать этому дереву)
+	Binary_Search_Tree(Binary_Search_Tree && tree, const Allocator& alloc)
+		: cmp(tree.cmp), Alc(alloc), dummy(make_dummy())
+	{
+		if (Alc == tree.Alc)
+			take_nodes(tree);
 		else
-			std::for_each(first, last, [this](T x) { insert(x); });
+			construct_copy(tree);
 	}
 
-	Binary_Search_Tree(const Binary_Search_Tree & tree) : dummy(make_dummy())
-	{	//  Размер задаём
-		tree_size = tree.tree_size;
+	private:
+
+	using alloc_traits = std::allocator_traits<AllocType>;
+
+	//  Копирование узлов другого дерева в пустое дерево
+	void copy_nodes(const Binary_Search_Tree & tree)
+	{
 		if (tree.empty()) return;
+		tree.settle_deferred();
 
-		dummy->parent = recur_copy_tree(tree.dummy->parent, tree.dummy);
+		//  Размер устанавливается, только когда копирование завершилось: при исключении дерево остаётся пустым
+		dummy->parent = recur_copy_tree(Alc, tree.dummy->parent, tree.dummy, copy_fork_depth(tree.tree_size));
+		tree_size = tree.tree_size;
 		dummy->parent->parent = dummy;
+		stats().allocated(tree_size);
 
 		//  Осталось установить min и max
 		dummy->left = iterator(dummy->parent).GetMin()._data();
 		dummy->right = iterator(dummy->parent).GetMax()._data();
 	}
 
-	private:
+	//  Копирование в конструкторе: если оно не удалось, деструктор вызван не будет, и фиктивную вершину освобождаем сами
+	void construct_copy(const Binary_Search_Tree & tree)
+	{
+		try {
+			copy_nodes(tree);
+		}
+		catch (...) {
+			delete_dummy(dummy);
+			throw;
+		}
+	}
+
+	//  Обмен узлами с деревом, аллокатор которого равен нашему (пустое дерево забирает узлы другого)
+	void take_nodes(Binary_Search_Tree & tree) noexcept
+	{
+		std::swap(dummy, tree.dummy);
+		std::swap(tree_size, tree.tree_size);
+		deferred.swap(tree.deferred);
+	}
+
+	//  Замена содержимого содержимым временного дерева при присваивании. Аллокатор забирается, только если
+	//    он распространяется при этом присваивании (иначе у временного дерева он такой же, как у нашего,
+	//    а сам аллокатор может быть вообще не присваиваемым, как std::pmr::polymorphic_allocator)
+	template<bool Propagate>
+	void replace_with(Binary_Search_Tree & tree) noexcept
+	{
+		using std::swap;
+		swap(cmp, tree.cmp);
+		if constexpr (Propagate)
+			swap(Alc, tree.Alc);
+		take_nodes(tree);
+	}
+
+	//  Деревья меньше этого размера копируются в одном потоке – запуск потоков дороже самого копирования
+	static constexpr size_type parallel_copy_threshold = 1 << 16;
+
+	//  Глубина, до которой копирование левых поддеревьев отдаётся отдельным потокам (0 – копировать в одном потоке).
+	//  Узлы выделяются параллельно, поэтому распараллеливаем только для аллокаторов без состояния (std::allocator и т.п.),
+	//    у которых все экземпляры взаимозаменяемы и которые сами по себе потокобезопасны
+	static int copy_fork_depth(size_type nodes_count)
+	{
+		if (!std::allocator_traits<AllocType>::is_always_equal::value || nodes_count < parallel_copy_threshold)
+			return 0;
+		int depth = 0;
+		for (unsigned threads = std::thread::hardware_concurrency(); threads > 1; threads >>= 1)
+			++depth;
+		return depth;
+	}
 
-    //  Рекурсивное копирование дерева
-	Node* recur_copy_tree(Node * source, const Node * source_dummy) 
+    //  Рекурсивное копирование дерева. Пока fork_depth > 0, левое поддерево копируется в отдельном потоке
+	//    со своей копией аллокатора, а правое – в текущем. При исключении уже скопированные поддеревья освобождаются
+	Node* recur_copy_tree(AllocType & alc, Node * source, const Node * source_dummy, int fork_depth = 0)
 	{
+		if (fork_depth <= 0)
+			return copy_subtree(alc, source, source_dummy);
+
 		//  Сначала создаём дочерние поддеревья
-		Node* left_sub_tree;
+		Node* left_sub_tree = dummy;
+		std::future<Node*> left_copy;
 		if (source->left != source_dummy)
-			left_sub_tree = recur_copy_tree(source->left, source_dummy);
-		else
-			left_sub_tree = dummy;
-
-		Node* right_sub_tree;
-		if (source->right != source_dummy)
-			right_sub_tree = recur_copy_tree(source->right, source_dummy);
-		else
-			right_sub_tree = dummy;
-		
-		//  Теперь создаём собственный узел
-		Node* current = make_node(source->data, nullptr, left_sub_tree, right_sub_tree);
+			left_copy = std::async(std::launch::async, [this, &alc, source, source_dummy, fork_depth]() {
+				AllocType worker_alc(alc);
+				return recur_copy_tree(worker_alc, source->left, source_dummy, fork_depth - 1);
+			});
+
+		Node* right_sub_tree = dummy;
+		Node* current;
+		try {
+			if (source->right != source_dummy)
+				right_sub_tree = recur_copy_tree(alc, source->right, source_dummy, fork_depth - 1);
+			if (left_copy.valid())
+				left_sub_tree = left_copy.get();
+			//  Теперь создаём собственный узел
+			current = make_node(alc, source->data, nullptr, left_sub_tree, right_sub_tree);
+		}
+		catch (...) {
+			free_halves(alc, left_copy, left_sub_tree, right_sub_tree);
+			throw;
+		}
+		copy_augment(current, source);
 		//  Устанавливаем родителей
 		if (source->right != source_dummy)
 			current->right->parent = current;
@@ -418,17 +943,194 @@ public:
 		return current;
 	}
 
+	//  Копирование поддерева без рекурсии: обход в прямом порядке по ссылкам на родителей одновременно
+	//    в исходном дереве и в копии. Глубина вырожденного дерева может достигать его размера, так что
+	//    рекурсия здесь переполнила бы стек. Родитель корня копии устанавливает вызывающий
+	Node* copy_subtree(AllocType & alc, Node * source, const Node * source_dummy)
+	{
+		Node* root = make_node(alc, source->data, nullptr, dummy, dummy);
+		copy_augment(root, source);
+		Node* from = source;
+		Node* to = root;
+		try {
+			for (;;) {
+				if (from->left != source_dummy && to->left == dummy) {
+					to->left = make_node(alc, from->left->data, to, dummy, dummy);
+					from = from->left;
+					to = to->left;
+					copy_augment(to, from);
+				}
+				else if (from->right != source_dummy && to->right == dummy) {
+					to->right = make_node(alc, from->right->data, to, dummy, dummy);
+					from = from->right;
+					to = to->right;
+					copy_augment(to, from);
+				}
+				else if (from == source)
+					return root;
+				else {
+					from = from->parent;
+					to = to->parent;
+				}
+			}
+		}
+		catch (...) {
+			//  Недостроенная копия – обычное поддерево, у которого часть ссылок ещё указывает на фиктивную вершину
+			free_subtree(alc, root, dummy);
+			throw;
+		}
+	}
+
+	//  Освобождение готовых половин поддерева, когда построение его корня прервано исключением. Левая половина
+	//    могла строиться в другом потоке – её дожидаемся; если и там было исключение, освобождать нечего
+	void free_halves(AllocType & alc, std::future<Node*> & left_async, Node* left, Node* right) noexcept
+	{
+		if (left_async.valid()) {
+			try {
+				left = left_async.get();
+			}
+			catch (...) {
+				left = dummy;
+			}
+		}
+		free_subtree(alc, left, dummy);
+		free_subtree(alc, right, dummy);
+	}
+
+	//  Массивы меньше этого размера сортируются в одном потоке
+	static constexpr size_type parallel_sort_threshold = 1 << 15;
+
+	//  Сортировка ключей с удалением эквивалентных. Уже упорядоченный массив не сортируется.
+	//  Большой массив делится на куски по числу ядер, куски сортируются параллельно, а затем
+	//    попарно сливаются – тоже параллельно, пока не останется один кусок
+	void sort_unique(std::vector<T> & keys) const
+	{
+		auto less = [this](const T& a, const T& b) { return cmp(a, b); };
+		if (!std::is_sorted(keys.begin(), keys.end(), less)) {
+			size_type chunks = std::max(1u, std::thread::hardware_concurrency());
+			if (keys.size() < parallel_sort_threshold || chunks == 1)
+				std::sort(keys.begin(), keys.end(), less);
+			else {
+				//  Границы кусков: bounds[i] .. bounds[i+1]
+				std::vector<size_type> bounds;
+				for (size_type i = 0; i <= chunks; ++i)
+					bounds.push_back(keys.size() * i / chunks);
+
+				std::vector<std::future<void>> tasks;
+				for (size_type i = 0; i < chunks; ++i)
+					tasks.push_back(std::async(std::launch::async, [&keys, &bounds, less, i]() {
+						std::sort(keys.begin() + bounds[i], keys.begin() + bounds[i + 1], less);
+					}));
+				for (auto & task : tasks) task.get();
+
+				//  Попарное слияние соседних кусков, на каждом шаге количество кусков уменьшается вдвое
+				while (bounds.size() > 2) {
+					tasks.clear();
+					std::vector<size_type> merged;
+					for (size_type i = 0; i + 2 < bounds.size(); i += 2) {
+						merged.push_back(bounds[i]);
+						tasks.push_back(std::async(std::launch::async, [&keys, &bounds, less, i]() {
+							std::inplace_merge(keys.begin() + bounds[i], keys.begin() + bounds[i + 1], keys.begin() + bounds[i + 2], less);
+						}));
+					}
+					//  Нечётный последний кусок переходит на следующий шаг без слияния
+					if (bounds.size() % 2 == 0)
+						merged.push_back(bounds[bounds.size() - 2]);
+					merged.push_back(bounds.back());
+					for (auto & task : tasks) task.get();
+					bounds.swap(merged);
+				}
+			}
+		}
+		//  В отсортированном массиве эквивалентные ключи стоят рядом
+		keys.erase(std::unique(keys.begin(), keys.end(), [this](const T& a, const T& b) { return !cmp(a, b); }), keys.end());
+	}
+
+	//  Построение идеально сбалансированного дерева из отсортированного массива без повторов.
+	//  Дерево должно быть пустым
+	void build_from_sorted(const T * first, const T * last)
+	{
+		if (first == last) return;
+		drop_deferred();
+		dummy->parent = recur_build_tree(Alc, first, last, copy_fork_depth(last - first));
+		tree_size = last - first;
+		dummy->parent->parent = dummy;
+		stats().allocated(tree_size);
+		dummy->left = iterator(dummy->parent).GetMin()._data();
+		dummy->right = iterator(dummy->parent).GetMax()._data();
+	}
+
+	//  Рекурсивное построение поддерева из непустого отсортированного отрезка: корень – средний элемент.
+	//    Как и при копировании, левая половина верхних уровней строится в отдельном потоке
+	Node* recur_build_tree(AllocType & alc, const T * first, const T * last, int fork_depth = 0)
+	{
+		const T * center = first + (last - first) / 2;
+
+		Node* left_sub_tree = dummy;
+		std::future<Node*> left_build;
+		if (first != center) {
+			if (fork_depth > 0)
+				left_build = std::async(std::launch::async, [this, &alc, first, center, fork_depth]() {
+					AllocType worker_alc(alc);
+					return recur_build_tree(worker_alc, first, center, fork_depth - 1);
+				});
+			else
+				left_sub_tree = recur_build_tree(alc, first, center);
+		}
+
+		Node* right_sub_tree = dummy;
+		Node* current;
+		try {
+			if (center + 1 != last)
+				right_sub_tree = recur_build_tree(alc, center + 1, last, fork_depth - 1);
+			if (left_build.valid())
+				left_sub_tree = left_build.get();
+			current = make_node(alc, *center, nullptr, left_sub_tree, right_sub_tree);
+		}
+		catch (...) {
+			free_halves(alc, left_build, left_sub_tree, right_sub_tree);
+			throw;
+		}
+		if (left_sub_tree != dummy)
+			left_sub_tree->parent = current;
+		if (right_sub_tree != dummy)
+			right_sub_tree->parent = current;
+		augment_node(current);
+		return current;
+	}
+
 	public:
-	const Binary_Search_Tree & operator=(const Binary_Search_Tree &tree)
+	//  Присваивания строят новое содержимое во временном дереве с тем аллокатором, который должен остаться
+	//    у этого дерева (в зависимости от propagate_on_container_*), и затем забирают его узлы
+	Binary_Search_Tree & operator=(const Binary_Search_Tree &tree)
 	{
 		if (this == &tree) return *this;
 		
-		Binary_Search_Tree tmp{tree};
-		swap(tmp);
+		constexpr bool propagate = alloc_traits::propagate_on_container_copy_assignment::value;
+		Binary_Search_Tree tmp(tree, propagate ? allocator_type(tree.Alc) : allocator_type(Alc));
+		replace_with<propagate>(tmp);
 		
 		return *this;
 	}
 
+	Binary_Search_Tree & operator=(Binary_Search_Tree &&tree)
+	{
+		if (this == &tree) return *this;
+
+		constexpr bool propagate = alloc_traits::propagate_on_container_move_assignment::value;
+		Binary_Search_Tree tmp(std::move(tree), propagate ? allocator_type(tree.Alc) : allocator_type(Alc));
+		replace_with<propagate>(tmp);
+
+		return *this;
+	}
+
+	Binary_Search_Tree & operator=(std::initializer_list<T> il)
+	{
+		Binary_Search_Tree tmp(il, cmp, allocator_type(Alc));
+		replace_with<false>(tmp);
+		return *this;
+	}
+
 	//===============================================================================================================
 	//  Это "самодельный" блок для тестирования
 	
@@ -469,44 +1171,265 @@ public:
 	}
 	//==============================================================================================================
 	
-	size_type size() const { return tree_size; }
-
-	// Обмен содержимым двух контейнеров
-	void swap(Binary_Search_Tree & other) noexcept {
-		std::swap(dummy, other.dummy);
+	size_type size() const
+	{
+		settle_deferred();
+		return tree_size;
+	}
 
-		//  Обмен размера множеств
-		std::swap(tree_size, other.tree_size);
+	//  Высота, средняя глубина и гистограмма глубин за один проход без стека: по ссылкам на родителей,
+	//    глубина меняется на единицу при каждом шаге вниз или вверх. Не зависит от политики статистики
+	Tree_Shape_Stats shape_stats() const
+	{
+		settle_deferred();
+		Tree_Shape_Stats result;
+		if (empty()) return result;
+		std::uint64_t depth_sum = 0;
+		size_t depth = 0;
+		const Node* from = dummy;
+		const Node* node = dummy->parent;
+		while (node != dummy) {
+			const Node* next;
+			if (from == node->parent) {
+				//  Пришли сверху – учитываем узел
+				if (result.depth_histogram.size() <= depth)
+					result.depth_histogram.resize(depth + 1);
+				++result.depth_histogram[depth];
+				depth_sum += depth;
+				next = node->left != dummy ? node->left : node->right != dummy ? node->right : node->parent;
+			}
+			else if (from == node->left && node->right != dummy)
+				next = node->right;
+			else
+				next = node->parent;
+			from = node;
+			node = next;
+			if (node == from->parent) --depth; else ++depth;
+		}
+		result.height = result.depth_histogram.size();
+		result.average_depth = static_cast<double>(depth_sum) / tree_size;
+		return result;
 	}
 
-	//  Вставка элемента по значению. 
-	std::pair<iterator, bool> insert(const T & value)
+	//  Высота дерева (число уровней) – тем же проходом по ссылкам на родителей, без дополнительной памяти
+	size_type height() const
 	{
-		iterator prev(dummy->parent);
-		//  Дерево пустое - создаём новый узел, 
-		if (prev.isNil())
-		{
-			//это в общем случае, здесь корень, конечно
-			//parent - root; right - most right; left - most left
-			//Node * new_node = new Node( value, dummy, dummy, dummy);
-			Node* new_node = make_node(value, dummy, dummy, dummy);
-			++tree_size;
-			dummy->parent = new_node;
-			dummy->left = new_node;
-			dummy->right = new_node;
-			return std::make_pair(iterator(new_node), true);
+		size_type result = 0, depth = 0;
+		const Node* from = dummy;
+		const Node* node = dummy->parent;
+		while (node != dummy) {
+			const Node* next;
+			if (from == node->parent) {
+				result = std::max(result, depth + 1);
+				next = node->left != dummy ? node->left : node->right != dummy ? node->right : node->parent;
+			}
+			else if (from == node->left && node->right != dummy)
+				next = node->right;
+			else
+				next = node->parent;
+			from = node;
+			node = next;
+			if (node == from->parent) --depth; else ++depth;
 		}
+		return result;
+	}
 
-		//  Дерево не пустое
-		iterator current = iterator(dummy->parent);
+	//  Перестройка в идеально сбалансированное (полное) дерево на месте алгоритмом Дэя – Стаута – Уоррена:
+	//    правыми поворотами дерево вытягивается в правую цепочку, затем сериями левых поворотов вдоль цепочки
+	//    сворачивается обратно, каждая серия вдвое укорачивает цепочку. O(n) времени, O(1) памяти, узлы не
+	//    выделяются и не копируются, итераторы остаются действительными. Повороты учитываются в stats().relinked()
+	Tree_Rebalance_Stats rebalance()
+	{
+		settle_deferred();
+		Tree_Rebalance_Stats result;
+		result.height_before = height();
+		if (tree_size > 2) {
+			tree_to_vine();
+			//  Нижний неполный уровень: столько узлов, сколько не хватает до 2^k - 1
+			size_type full = 1;
+			while (full * 2 + 1 <= tree_size) full = full * 2 + 1;
+			compress_vine(tree_size - full);
+			for (size_type length = full; length > 1; length /= 2)
+				compress_vine(length / 2);
+			augment_all();
+		}
+		result.height_after = height();
+		return result;
+	}
 
-		while (current.notNil()) {
-			prev = current;
-			if (cmp(value, *current)) {
+	//  Перестройка под известное распределение обращений: weight(key) – частота поиска ключа (неотрицательное
+	//    число). Узлы перевязываются правилом Мельхорна: корнем отрезка становится ключ, на который приходится
+	//    середина суммарного веса отрезка, поэтому частые ключи оказываются близко к корню, а глубина ключа
+	//    не больше log2(W / w) + 2, что близко к оптимальному дереву. Чтобы редкие и нулевые ключи не уходили
+	//    слишком глубоко, к каждому весу добавляется 1/1024 среднего веса. O(n log n) времени, O(n) памяти на
+	//    указатели и префиксные суммы; узлы не выделяются и не копируются, итераторы остаются действительными
+	template<class Weight>
+	Tree_Rebalance_Stats optimize(Weight weight)
+	{
+		settle_deferred();
+		Tree_Rebalance_Stats result;
+		result.height_before = height();
+		if (tree_size > 1) {
+			std::vector<Node*> nodes;
+			nodes.reserve(tree_size);
+			std::vector<double> prefix(1, 0.0);
+			prefix.reserve(tree_size + 1);
+			for (iterator it = begin(); it != end(); ++it) {
+				nodes.push_back(it._data());
+				prefix.push_back(prefix.back() + std::max(0.0, static_cast<double>(weight(*it))));
+			}
+			double total = prefix.back();
+			double floor = total > 0 ? total / tree_size / 1024 : 1.0;
+			for (size_type i = 1; i <= tree_size; ++i)
+				prefix[i] += floor * i;
+			relink_weighted(nodes, prefix);
+			stats().relinked(tree_size);
+			augment_all();
+		}
+		result.height_after = height();
+		return result;
+	}
+
+	//  Средняя глубина поиска (корень – глубина 1) при частотах weight(key); 0 для пустого дерева или нулевых весов
+	template<class Weight>
+	double expected_depth(Weight weight) const
+	{
+		double weighted = 0, total = 0;
+		size_type depth = 0;
+		const Node* from = dummy;
+		const Node* node = dummy->parent;
+		while (node != dummy) {
+			const Node* next;
+			if (from == node->parent) {
+				double w = static_cast<double>(weight(node->data));
+				weighted += w * (depth + 1);
+				total += w;
+				next = node->left != dummy ? node->left : node->right != dummy ? node->right : node->parent;
+			}
+			else if (from == node->left && node->right != dummy)
+				next = node->right;
+			else
+				next = node->parent;
+			from = node;
+			node = next;
+			if (node == from->parent) --depth; else ++depth;
+		}
+		return total > 0 ? weighted / total : 0.0;
+	}
+
+private:
+	//  Перевязка узлов по правилу Мельхорна. prefix[i] – суммарный вес узлов до i-го, веса положительны.
+	//    Глубина при сильно неравных весах может быть большой, поэтому отрезки обрабатываются через явный стек
+	void relink_weighted(const std::vector<Node*> & nodes, const std::vector<double> & prefix)
+	{
+		struct Segment
+		{
+			size_type first, last;
+			Node* parent;
+			Node** link;
+		};
+		std::vector<Segment> segments{ { 0, nodes.size(), dummy, &dummy->parent } };
+		while (!segments.empty()) {
+			Segment segment = segments.back();
+			segments.pop_back();
+			//  Узел, на вес которого приходится середина веса отрезка
+			double middle = (prefix[segment.first] + prefix[segment.last]) / 2;
+			size_type root = std::upper_bound(prefix.begin() + segment.first + 1, prefix.begin() + segment.last, middle) - prefix.begin() - 1;
+			Node* node = nodes[root];
+			*segment.link = node;
+			node->parent = segment.parent;
+			node->left = node->right = dummy;
+			if (segment.first < root)
+				segments.push_back({ segment.first, root, node, &node->left });
+			if (root + 1 < segment.last)
+				segments.push_back({ root + 1, segment.last, node, &node->right });
+		}
+		dummy->left = nodes.front();
+		dummy->right = nodes.back();
+	}
+
+private:
+	//  Ссылка на правую цепочку «сверху» от scanner; nullptr означает фиктивную вершину, у которой роль
+	//    правого дочернего исполняет ссылка на корень
+	Node*& vine_link(Node* scanner) noexcept { return scanner ? scanner->right : dummy->parent; }
+
+	void tree_to_vine()
+	{
+		Node* tail = nullptr;
+		Node* rest = dummy->parent;
+		while (rest != dummy) {
+			if (rest->left == dummy) {
+				tail = rest;
+				rest = rest->right;
+				continue;
+			}
+			//  Правый поворот: левый дочерний поднимается на место rest
+			stats().relinked();
+			Node* left = rest->left;
+			rest->left = left->right;
+			if (left->right != dummy) left->right->parent = rest;
+			left->right = rest;
+			rest->parent = left;
+			vine_link(tail) = left;
+			left->parent = tail ? tail : dummy;
+			rest = left;
+		}
+	}
+
+	//  count левых поворотов через узел вдоль правой цепочки, начиная от корня
+	void compress_vine(size_type count)
+	{
+		Node* scanner = nullptr;
+		for (size_type i = 0; i < count; ++i) {
+			stats().relinked();
+			Node* child = vine_link(scanner);
+			Node* next = child->right;
+			vine_link(scanner) = next;
+			next->parent = scanner ? scanner : dummy;
+			child->right = next->left;
+			if (next->left != dummy) next->left->parent = child;
+			next->left = child;
+			child->parent = next;
+			scanner = next;
+		}
+	}
+
+public:
+	// Обмен содержимым двух контейнеров
+	//  Аллокаторы обмениваются, только если этого требует propagate_on_container_swap; иначе они должны быть равны
+	void swap(Binary_Search_Tree & other) noexcept {
+		using std::swap;
+		if constexpr (alloc_traits::propagate_on_container_swap::value)
+			swap(Alc, other.Alc);
+		else
+			assert(Alc == other.Alc);
+		swap(cmp, other.cmp);
+		take_nodes(other);
+	}
+
+	//  Вставка элемента по значению. 
+	std::pair<iterator, bool> insert(const T & value)
+	{
+		iterator prev(dummy->parent);
+		//  Дерево пустое - создаём новый узел, 
+		if (prev.isNil())
+			return std::make_pair(iterator(link_new_node(dummy, true, value)), true);
+
+		//  Дерево не пустое
+		stats().lookup();
+		iterator current = iterator(dummy->parent);
+		//  Результат последнего сравнения – в какую сторону от prev вставлять
+		int order = 0;
+		const key_prefix kp = Prefix::make(value);
+
+		while (current.notNil()) {
+			prev = current;
+			order = compare3(value, kp, current._data());
+			if (order < 0) {
 				current = current.Left();
 				continue;
 			}
-			if (cmp(*current, value)) {
+			if (order > 0) {
 				current = current.Right();
 				continue;
 			}
@@ -514,40 +1437,64 @@ public:
 			return std::make_pair(iterator(current), false);
 		}
 		
-		//  Выделяем память под узел - это нужно делать по аналогии с созданием фиктивной вершины
-		Node* new_node = make_node(value, prev._data(), dummy, dummy);
-		++tree_size;
+		return std::make_pair(iterator(link_new_node(prev._data(), order < 0, value)), true);
+	}	
 
-		if (cmp(value, *prev)) 
-		{
-			//  налево
-			prev._data()->left = new_node;
-			//  Если prev был минимальным элементом дерева
-			if (dummy->left == prev._data()) dummy->left = new_node;
+protected:
+	//  Создание узла с ключом из args и подвешивание его листом к parent (слева, если to_left) – место
+	//    уже найдено спуском. Для пустого дерева parent – фиктивная вершина, новый узел становится корнем
+	template<class... Args>
+	Node* link_new_node(Node* parent, bool to_left, Args&&... args)
+	{
+		stats().allocated();
+		Node* new_node = emplace_node(Alc, parent, dummy, dummy, std::forward<Args>(args)...);
+		attach_node(new_node, parent, to_left);
+		return new_node;
+	}
+
+	//  Подвешивание готового узла без дочерних листом к parent – для нового узла и для узла, перевязываемого
+	//    с новым ключом (update_key)
+	void attach_node(Node* node, Node* parent, bool to_left)
+	{
+		node->parent = parent;
+		node->left = node->right = dummy;
+		++tree_size;
+		if (parent == dummy)
+			dummy->parent = dummy->left = dummy->right = node;
+		else if (to_left) {
+			parent->left = node;
+			//  Если parent был минимальным элементом дерева
+			if (dummy->left == parent) dummy->left = node;
 		}
-		else
-		{
-			// направо		
-			prev._data()->right = new_node;
-			if (dummy->right == prev._data()) dummy->right = new_node;
+		else {
+			parent->right = node;
+			if (dummy->right == parent) dummy->right = node;
 		}
-		return std::make_pair(iterator(new_node), true);
-	}	
+		augment_path(node);
+	}
+
+	static iterator make_iterator(Node* node) noexcept { return iterator(node); }
+	static Node* node_of(const_iterator it) noexcept { return it.data; }
+
+	//  Компаратор без копирования (key_comp возвращает копию)
+	const Compare& comparator() const noexcept { return cmp; }
+
+public:
 
 	iterator insert(const_iterator position, const value_type& x) {
 		//  Проверяем, корректно ли задана позиция для вставки: ... prev -> x -> position -> ...
 		//  2 5 6 7 10 11 15,    x = 8
 		//  position = 15
 		iterator prev(position);  //  указывает на элемент, предшествующий x
-		if (position.isNil() || cmp(x, *position)) {
+		if (position.isNil() || less(x, *position)) {
 			--prev;
 			//  пока prev >= x -> идём влево
-			while (prev.notNil() && cmp(x, *prev)) {
+			while (prev.notNil() && less(x, *prev)) {
 				position = prev--;
 			}
 		}
 		else {
-			while (position.notNil() && !cmp(x, *position)) {
+			while (position.notNil() && !less(x, *position)) {
 				prev = position++;
 			}
 		}
@@ -559,11 +1506,12 @@ public:
 			++tree_size;
 			Node* new_node = make_node(x, dummy, dummy, dummy);
 			dummy->parent = dummy->left = dummy->right = new_node;
+			augment_node(new_node);
 			return iterator(new_node);
 		}
 
-		//  Если у нас уже есть такой элемент? Возвращаем итератор без вставки
-		if (prev.notNil() && *prev == x) return prev;
+		//  Если у нас уже есть такой элемент? Возвращаем итератор без вставки (prev <= x, так что достаточно одного сравнения)
+		if (prev.notNil() && !less(*prev, x)) return prev;
 
 		//  Тут точно есть один элемент в дереве, поэтому корень не затронем
 
@@ -574,6 +1522,7 @@ public:
 			p_node->left = make_node(x, p_node, dummy, dummy);
 			++tree_size;
 			dummy->left = p_node->left;
+			augment_path(dummy->left);
 			return iterator(dummy->left);
 		}
 
@@ -584,6 +1533,7 @@ public:
 			++tree_size;
 			if(dummy->right == prev._data()) 
 				dummy->right = prev._data()->right;
+			augment_path(prev._data()->right);
 			return iterator(prev._data()->right);
 		}
 
@@ -591,27 +1541,182 @@ public:
 		//    тогда в этом поддереве самый левый - это position
 		position._data()->left = make_node(x, position._data(), dummy, dummy);
 		++tree_size;
+		augment_path(position._data()->left);
 		return iterator(position._data()->left);
 		//  Всё???
 	}
 
-	//  Не самый лучший вариант.
+	//  Добавление ключа в конец – для потоков возрастающих ключей (например, отметок времени). Если ключ больше
+	//    максимального, узел подвешивается справа к максимуму без спуска от корня, иначе – обычная вставка.
+	//    Чтобы цепочка максимумов не вытягивалась в список, правый путь дерева поддерживается как двоичный
+	//    счётчик: у узлов пути левые поддеревья – идеальные деревья убывающей высоты. Когда у последних двух
+	//    узлов пути левые поддеревья одной высоты h, поворот влево делает из них идеальное дерево высоты h+1.
+	//    Поворотов в среднем меньше одного на ключ, а дерево, выросшее добавлениями, имеет глубину не больше 2*log(n)
+	std::pair<iterator, bool> append(const T & value)
+	{
+		if (empty())
+			return std::make_pair(iterator(link_new_node(dummy, true, value)), true);
+		if (!less(dummy->right->data, value))
+			return insert(value);
+		Node* new_node = link_new_node(dummy->right, false, value);
+		rebalance_appended(new_node);
+		return std::make_pair(iterator(new_node), true);
+	}
+
+	//  Добавление пачки: подряд идущие возрастающие ключи добавляются в конец, остальные вставляются обычным образом
+	template <class InputIterator>
+	void append(InputIterator first, InputIterator last)
+	{
+		for (; first != last; ++first)
+			append(*first);
+	}
+
+private:
+	//  Повороты влево на правом пути, пока у последнего узла пути и его родителя левые поддеревья одной высоты.
+	//    Высота идеального поддерева – длина его левого пути; пути сравниваются одновременно, до конца короткого,
+	//    поэтому проверка на высоте h стоит O(h), а до высоты h очередь доходит лишь раз в 2^h добавлений
+	void rebalance_appended(Node* last)
+	{
+		for (Node* parent = last->parent; parent != dummy; parent = last->parent) {
+			Node* a = parent->left;
+			Node* b = last->left;
+			for (; a != dummy && b != dummy; a = a->left, b = b->left) {}
+			if (a != dummy || b != dummy) return;
+
+			//  Поворот: parent уходит влево от last, левое поддерево last становится правым у parent
+			stats().relinked();
+			Node* grand = parent->parent;
+			parent->right = last->left;
+			if (parent->right != dummy) parent->right->parent = parent;
+			last->left = parent;
+			parent->parent = last;
+			last->parent = grand;
+			if (grand == dummy) dummy->parent = last;
+			else grand->right = last;
+			//  Поддерево с корнем last содержит те же ключи, что раньше поддерево parent, – выше ничего не меняется
+			augment_node(parent);
+			augment_node(last);
+		}
+	}
+
+public:
+	//  Вставка диапазона. Пачка сортируется, а затем в зависимости от соотношения размеров пачки и дерева
+	//    либо вставляется поэлементно с «пальцем» (маленькая пачка в большое дерево), либо сливается
+	//    с деревом с перестройкой в сбалансированное (большая пачка) – тогда узлы дерева не перевыделяются
 	template <class InputIterator>
 	void insert(InputIterator first, InputIterator last) {
-		while (first != last) insert(*first++);
+		std::vector<T> keys(first, last);
+		sort_unique(keys);
+		if (keys.empty()) return;
+
+		if (empty()) {
+			build_from_sorted(keys.data(), keys.data() + keys.size());
+			return;
+		}
+
+		//  Поэлементная вставка стоит ~ k*log(n), слияние – n+k
+		settle_deferred();
+		size_type height_estimate = 1;
+		for (size_type n = tree_size; n > 1; n >>= 1)
+			++height_estimate;
+		if (keys.size() * height_estimate < tree_size)
+			finger_insert(keys);
+		else
+			merge_insert(keys);
+	}
+
+private:
+	//  Поэлементная вставка отсортированной пачки. Если очередной ключ попадает между предыдущим
+	//    вставленным элементом и его последователем, то место вставки известно без спуска от корня
+	void finger_insert(const std::vector<T> & keys)
+	{
+		iterator finger = end();
+		for (const T & key : keys) {
+			if (finger != end()) {
+				iterator next = finger;
+				++next;
+				if (next == end() || less(key, *next)) {
+					finger = insert(next, key);
+					continue;
+				}
+			}
+			finger = insert(key).first;
+		}
+	}
+
+	//  Слияние отсортированной пачки с деревом: узлы дерева выписываются по порядку, между ними встают
+	//    новые узлы для отсутствующих ключей, после чего все узлы перевязываются в сбалансированное дерево
+	void merge_insert(const std::vector<T> & keys)
+	{
+		std::vector<Node*> nodes;
+		nodes.reserve(tree_size + keys.size());
+		size_type created = 0;
+		try {
+			auto key = keys.begin();
+			for (iterator it = begin(); it != end(); ++it) {
+				int order = 1;
+				for (; key != keys.end() && (order = compare3(*key, *it)) < 0; ++key, ++created)
+					nodes.push_back(make_node(*key, nullptr, dummy, dummy));
+				//  Такой ключ уже есть в дереве
+				if (key != keys.end() && order == 0)
+					++key;
+				nodes.push_back(it._data());
+			}
+			for (; key != keys.end(); ++key, ++created)
+				nodes.push_back(make_node(*key, nullptr, dummy, dummy));
+		}
+		catch (...) {
+			//  Дерево ещё не тронуто, удаляем только новые узлы
+			for (Node* node : nodes)
+				if (node->parent == nullptr)
+					delete_node(node);
+			throw;
+		}
+		tree_size += created;
+		stats().relinked(nodes.size());
+		relink_balanced(nodes);
+	}
+
+	//  Перевязка узлов, заданных в порядке возрастания ключей, в идеально сбалансированное дерево.
+	//    Узлы не перевыделяются, меняются только указатели
+	void relink_balanced(std::vector<Node*> & nodes)
+	{
+		if (nodes.empty()) {
+			dummy->parent = dummy->left = dummy->right = dummy;
+			return;
+		}
+		dummy->parent = recur_relink(nodes.data(), nodes.data() + nodes.size());
+		dummy->parent->parent = dummy;
+		dummy->left = nodes.front();
+		dummy->right = nodes.back();
+	}
+
+	Node* recur_relink(Node ** first, Node ** last)
+	{
+		Node ** center = first + (last - first) / 2;
+		Node * current = *center;
+		current->left = first != center ? recur_relink(first, center) : dummy;
+		current->right = center + 1 != last ? recur_relink(center + 1, last) : dummy;
+		if (current->left != dummy) current->left->parent = current;
+		if (current->right != dummy) current->right->parent = current;
+		augment_node(current);
+		return current;
 	}
 
+public:
+
 	iterator find(const value_type& value) const {
-		
+		stats().lookup();
 		iterator current = iterator(dummy->parent);
+		const key_prefix kp = Prefix::make(value);
 
 		while (current.notNil()) {
-
-			if (cmp(value, *current)) {
+			int order = compare3(value, kp, current._data());
+			if (order < 0) {
 				current = current.Left();
 				continue;
 			}
-			if (cmp(*current, value)) {
+			if (order > 0) {
 				current = current.Right();
 				continue;
 			}
@@ -621,16 +1726,19 @@ public:
 		return current;
 	}
 
+	//  Первый элемент, не меньший key
 	iterator lower_bound(const value_type& key) {
-		iterator current{ dummy->parent }, result{ dummy->parent };
+		stats().lookup();
+		iterator current{ dummy->parent }, result{ dummy };
+		const key_prefix kp = Prefix::make(key);
 
 		while (current.notNil()) {
-			if (!cmp(key, *current)) {
-				result = current;
+			if (less(current._data(), key, kp))
 				current = current.Right();
-			}
-			else
+			else {
+				result = current;
 				current = current.Left();
+			}
 		}
 
 		return result;
@@ -640,15 +1748,16 @@ public:
 		return const_iterator(const_cast<Binary_Search_Tree *>(this)->lower_bound(key));
 	}
 
+	//  Первый элемент, больший key
 	iterator upper_bound(const value_type& key) {
-
-		iterator current{ dummy->parent }, result{ dummy->parent };
+		stats().lookup();
+		iterator current{ dummy->parent }, result{ dummy };
+		const key_prefix kp = Prefix::make(key);
 		while (current.notNil()) {
 			
 			//  если тек > ключа - запомнить, налево
-			//  byfxt 
 
-			if (cmp(key, *current)) {
+			if (less(key, kp, current._data())) {
 				result = current;
 				current = current.Left();
 			}
@@ -667,19 +1776,334 @@ public:
 		return find(key) != end() ? 1 : 0;
 	}
 
+	//  Для set диапазон содержит не более одного элемента, поэтому достаточно одного спуска:
+	//    запоминаем последний узел, от которого шагнули налево, – это первый больший key
 	std::pair<const_iterator, const_iterator> equal_range(const value_type& key) const {
-		const_iterator current{ dummy->parent }, left{ dummy->parent }, right{ dummy->parent };
+		stats().lookup();
+		const_iterator current{ dummy->parent }, greater{ dummy };
+		const key_prefix kp = Prefix::make(key);
 		while (current.notNil()) {
-			if (!cmp(key, *current)) {
-				left = current;
+			int order = compare3(key, kp, current._data());
+			if (order < 0) {
+				greater = current;
+				current = current.Left();
+			}
+			else if (order > 0)
 				current = current.Right();
+			else {
+				//  Следующий за найденным – минимум правого поддерева или последний «левый поворот»
+				if (current.Right().notNil())
+					greater = current.Right().GetMin();
+				return std::make_pair(current, greater);
 			}
+		}
+		return std::make_pair(greater, greater);
+	}
+
+	//  Диапазон строк, начинающихся с prefix: [lower_bound(prefix), lower_bound(следующий за prefix префикс)).
+	//    Следующий префикс получается отбрасыванием хвостовых байтов 0xFF и увеличением последнего байта
+	std::pair<const_iterator, const_iterator> prefix_range(const T& prefix) const
+		requires std::is_same_v<T, std::string> && Prefix::enabled
+	{
+		std::string next_prefix = prefix;
+		while (!next_prefix.empty() && static_cast<unsigned char>(next_prefix.back()) == 0xFF)
+			next_prefix.pop_back();
+		if (next_prefix.empty())
+			return std::make_pair(lower_bound(prefix), end());
+		next_prefix.back() = static_cast<char>(static_cast<unsigned char>(next_prefix.back()) + 1);
+		return std::make_pair(lower_bound(prefix), lower_bound(next_prefix));
+	}
+
+	//  Обход всех элементов по возрастанию с вызовом f(const T&) без итераторов. Если f возвращает bool,
+	//    то false останавливает обход. Возвращает false, если обход был остановлен.
+	//  Обход идёт по явному стеку, а не по ссылкам на родителей, f подставляется в цикл, а правый дочерний
+	//    узел запрашивается в кэш заранее – к нему обход перейдёт после левого поддерева
+	template<class Function>
+	bool for_each(Function f) const
+	{
+		return visit_in_order(dummy->parent, nullptr, f);
+	}
+
+	//  То же для элементов из [lo, hi) – тех же, что в [lower_bound(lo), lower_bound(hi)).
+	//    Стек заполняется путём от корня к первому элементу, не меньшему lo
+	template<class Function>
+	bool for_each_in_range(const T& lo, const T& hi, Function f) const
+	{
+		stats().lookup();
+		Traversal_Stack stack;
+		const key_prefix kp = Prefix::make(lo);
+		for (const Node* node = dummy->parent; node != dummy; )
+			if (less(node, lo, kp))
+				node = node->right;
 			else {
-				right = current;
-				current = current.Left();
+				stack.push(node);
+				prefetch_for_read(node->right);
+				node = node->left;
+			}
+		return visit_in_order(stack, dummy, &hi, f);
+	}
+
+	//  Разбиение дерева на не более чем parts идущих подряд непустых диапазонов [first, last) для параллельной обработки.
+	//    Размеры поддеревьев в узлах не хранятся, поэтому диапазоны равны лишь приблизительно: дерево делится
+	//    на мелкие части по корням поддеревьев, и соседние части объединяются по оценкам их размеров.
+	//    Время – O(parts * log n) для сбалансированного дерева
+	std::vector<std::pair<iterator, iterator>> split_ranges(size_type parts) const
+	{
+		settle_deferred();
+		std::vector<std::pair<iterator, iterator>> ranges;
+		parts = std::max<size_type>(1, std::min(parts, tree_size));
+		std::vector<Traversal_Part> split = split_parts(parts * parts_per_range);
+		double total = 0;
+		for (const Traversal_Part& part : split)
+			total += part.weight;
+
+		double accumulated = 0;
+		Node* first = nullptr;
+		for (const Traversal_Part& part : split) {
+			if (!first) first = part.head ? part.head : leftmost(part.root);
+			accumulated += part.weight;
+			if (accumulated >= total * (ranges.size() + 1) / parts || part.last == dummy) {
+				ranges.emplace_back(iterator(first), iterator(part.last));
+				first = nullptr;
+			}
+		}
+		return ranges;
+	}
+
+	//  Параллельный вызов f(const T&) для всех элементов, как при std::for_each(std::execution::par, ...):
+	//    f может вызываться одновременно из нескольких потоков. Порядок вызовов внутри части – по
+	//    возрастанию; false, возвращённое f, останавливает обход только своей части.
+	//  threads = 0 – по числу ядер, для небольших деревьев – в одном потоке.
+	//  Дерево во время обхода изменять нельзя
+	template<class Function>
+	void parallel_for_each(Function f, size_type threads = 0) const
+	{
+		threads = parallel_threads(threads);
+		run_parts(split_parts(threads * parts_per_range), threads, [this, &f](const Traversal_Part& part, size_t) {
+			if (part.head && !invoke_visitor(f, part.head->data)) return;
+			visit_in_order(part.root, nullptr, f);
+		});
+	}
+
+	//  Параллельная свёртка: в каждой части acc = reduce(acc, key), начиная с identity, затем результаты
+	//    частей объединяются по порядку через combine. identity должен быть нейтральным для combine,
+	//    combine – ассоциативной (коммутативность не требуется)
+	template<class Result, class Reduce, class Combine>
+	Result parallel_reduce(Result identity, Reduce reduce, Combine combine, size_type threads = 0) const
+	{
+		threads = parallel_threads(threads);
+		std::vector<Traversal_Part> split = split_parts(threads * parts_per_range);
+		//  Результат части – в отдельном объекте на своей строке кэша: std::vector<bool> хранил бы соседние
+		//    результаты в битах одного слова, и запись из разных потоков была бы гонкой
+		struct alignas(64) Partial_Result
+		{
+			Result value;
+		};
+		std::vector<Partial_Result> partial(split.size(), Partial_Result{ identity });
+		run_parts(split, threads, [this, &reduce, &partial](const Traversal_Part& part, size_t index) {
+			Result& acc = partial[index].value;
+			auto step = [&acc, &reduce](const T& key) { acc = reduce(std::move(acc), key); };
+			if (part.head) step(part.head->data);
+			visit_in_order(part.root, nullptr, step);
+		});
+		Result result = std::move(identity);
+		for (Partial_Result& part : partial)
+			result = combine(std::move(result), std::move(part.value));
+		return result;
+	}
+
+private:
+	//  Часть дерева для параллельного обхода: необязательный первый узел head, за ним всё поддерево root
+	//    (root может быть фиктивной вершиной); last – узел, следующий за частью (или фиктивная вершина)
+	struct Traversal_Part
+	{
+		Node* head;
+		Node* root;
+		Node* last;
+		double weight;
+	};
+
+	Node* leftmost(Node* node) const
+	{
+		if (node == dummy) return node;
+		while (node->left != dummy)
+			node = node->left;
+		return node;
+	}
+
+	//  Оценка числа узлов поддерева по Кнуту: спуск по случайному пути с суммированием произведений числа
+	//    детей на пройденных уровнях даёт несмещённую оценку; берётся среднее по нескольким спускам.
+	//    Случайность детерминирована (от адреса корня), чтобы разбиение одного дерева было воспроизводимым.
+	//    Спуск ограничен max_depth уровнями – для вырожденных деревьев оценка занижается, но остаётся дешёвой
+	double estimate_subtree_size(const Node* root) const
+	{
+		constexpr int probes = 16, max_depth = 128;
+		std::uint64_t random = reinterpret_cast<std::uintptr_t>(root) | 1;
+		double total = 0;
+		for (int probe = 0; probe < probes; ++probe) {
+			double width = 1;
+			int depth = 0;
+			for (const Node* node = root; node != dummy && depth < max_depth; ++depth) {
+				total += width;
+				random ^= random << 13; random ^= random >> 7; random ^= random << 17;
+				if (node->left == dummy)
+					node = node->right;
+				else if (node->right == dummy)
+					node = node->left;
+				else {
+					width *= 2;
+					node = (random & 1) ? node->left : node->right;
+				}
 			}
 		}
-		return std::make_pair(left, right);
+		return total / probes;
+	}
+
+	Traversal_Part make_part(Node* head, Node* root, Node* last) const
+	{
+		return Traversal_Part{ head, root, last, (head ? 1 : 0) + estimate_subtree_size(root) };
+	}
+
+	//  Деление части с наибольшей оценкой по корню её поддерева r: [head, левое поддерево r) и [r, правое поддерево r).
+	//    Части хранятся в списке по порядку, очередь с приоритетом выбирает следующую для деления
+	std::vector<Traversal_Part> split_parts(size_type parts) const
+	{
+		settle_deferred();
+		std::vector<Traversal_Part> result;
+		if (tree_size == 0) return result;
+		parts = std::max<size_type>(1, std::min(parts, tree_size));
+
+		using Position = typename std::list<Traversal_Part>::iterator;
+		std::list<Traversal_Part> ordered{ make_part(nullptr, dummy->parent, dummy) };
+		auto lighter = [](Position a, Position b) { return a->weight < b->weight; };
+		std::priority_queue<Position, std::vector<Position>, decltype(lighter)> heaviest(lighter);
+		heaviest.push(ordered.begin());
+		while (ordered.size() < parts && !heaviest.empty()) {
+			Position part = heaviest.top();
+			heaviest.pop();
+			Node* root = part->root;
+			Traversal_Part right = make_part(root, root->right, part->last);
+			if (part->head || root->left != dummy) {
+				*part = make_part(part->head, root->left, root);
+				if (part->root != dummy) heaviest.push(part);
+				part = ordered.insert(std::next(part), right);
+			}
+			else
+				*part = right;
+			if (part->root != dummy) heaviest.push(part);
+		}
+		result.assign(ordered.begin(), ordered.end());
+		return result;
+	}
+
+	//  Деление корнем поддерева почти всегда неравное, поэтому частей делается больше, чем диапазонов или потоков:
+	//    диапазоны собираются из соседних частей, а потоки разбирают части по очереди
+	static constexpr size_type parts_per_range = 8;
+
+	//  Число потоков параллельного обхода по умолчанию (threads = 0): по числу ядер, небольшие деревья – в одном потоке
+	size_type parallel_threads(size_type threads) const
+	{
+		if (threads != 0) return threads;
+		settle_deferred();
+		return tree_size < parallel_copy_threshold ? 1 : std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	//  Обход частей вызовами visit(part, номер части) в threads потоках: вызывающий поток и задачи std::async
+	//    берут части по очереди через общий счётчик. Исключение передаётся вызывающему после завершения всех задач
+	template<class Visit>
+	void run_parts(const std::vector<Traversal_Part>& split, size_type threads, Visit visit) const
+	{
+		std::atomic<size_t> next{ 0 };
+		auto run = [&visit, &split, &next]() {
+			for (size_t index; (index = next++) < split.size(); )
+				visit(split[index], index);
+		};
+		std::vector<std::future<void>> tasks;
+		for (size_t i = 1; i < std::min<size_t>(threads, split.size()); ++i)
+			tasks.push_back(std::async(std::launch::async, run));
+		std::exception_ptr failure;
+		try {
+			run();
+		}
+		catch (...) {
+			failure = std::current_exception();
+		}
+		for (auto& task : tasks)
+			try {
+				task.get();
+			}
+			catch (...) {
+				if (!failure) failure = std::current_exception();
+			}
+		if (failure) std::rethrow_exception(failure);
+	}
+
+protected:
+	//  Стек обхода: до 64 уровней без выделения памяти, глубже (вырожденное дерево) – в векторе
+	class Traversal_Stack
+	{
+		static constexpr size_t inline_capacity = 64;
+		const Node* inline_nodes[inline_capacity];
+		std::vector<const Node*> spilled;
+		size_t count = 0;
+	public:
+		bool empty() const noexcept { return count == 0; }
+		void push(const Node* node)
+		{
+			if (count < inline_capacity)
+				inline_nodes[count] = node;
+			else
+				spilled.push_back(node);
+			++count;
+		}
+		const Node* pop() noexcept
+		{
+			--count;
+			if (count < inline_capacity)
+				return inline_nodes[count];
+			const Node* node = spilled.back();
+			spilled.pop_back();
+			return node;
+		}
+	};
+
+	//  Вызов посетителя обхода: если f возвращает bool, то false останавливает обход. Результат любого другого типа,
+	//    даже приводимый к bool (например, f(k) { return sum += k; }), игнорируется
+	template<class Function>
+	static bool invoke_visitor(Function& f, const T& key)
+	{
+		if constexpr (std::is_same_v<std::invoke_result_t<Function&, const T&>, bool>)
+			return static_cast<bool>(f(key));
+		else {
+			f(key);
+			return true;
+		}
+	}
+
+private:
+	template<class Function>
+	bool visit_in_order(const Node* root, const T* hi, Function& f) const
+	{
+		Traversal_Stack stack;
+		return visit_in_order(stack, root, hi, f);
+	}
+
+	//  Симметричный обход: stack – ещё не посещённые предки, node – корень ещё не пройденного поддерева.
+	//    hi (если задан) – граница, на первом элементе не меньше которой обход заканчивается
+	template<class Function>
+	bool visit_in_order(Traversal_Stack& stack, const Node* node, const T* hi, Function& f) const
+	{
+		for (;;) {
+			for (; node != dummy; node = node->left) {
+				stack.push(node);
+				prefetch_for_read(node->right);
+			}
+			if (stack.empty()) return true;
+			node = stack.pop();
+			if (hi && !less(node->data, *hi)) return true;
+			if (!invoke_visitor(f, node->data)) return false;
+			node = node->right;
+		}
 	}
 
 protected:
@@ -709,7 +2133,10 @@ protected:
 					dummy->left = leaf.Parent()._data();
 			}		
 		//  удалить узел
+		Node* parent = leaf._data()->parent;
 		delete_node(leaf._data());
+		--tree_size;
+		augment_path(parent);
 		return 1;
 	}
 
@@ -720,6 +2147,7 @@ protected:
 
 		//  Находим максимальный элемент слева. У него нет правого дочернего, и он не может быть корнем или самым правым
 		iterator left_max = node.Left().GetMax();
+		stats().relinked();
 
 		//  Рассмотрим случай, когда левый максимальный является прямым потомком node
 		if (node.Left() == left_max) {
@@ -752,6 +2180,7 @@ protected:
 					dummy->parent = left_max._data();
 
 			node.setParent(left_max);
+			augment_path(node._data());
 			return node;
 		}
 		
@@ -768,7 +2197,7 @@ protected:
 			if (node.IsRight())
 				node.Parent().setRight(left_max);
 			else
-				node.setLeft(left_max);
+				node.Parent().setLeft(left_max);
 		//  Правое поддерево node
 		node.Right().setParent(left_max);
 		left_max.setRight(node.Right());
@@ -786,6 +2215,7 @@ protected:
 		iterator tmp = node.Parent();
 		node.setParent(left_max.Parent());
 		left_max.setParent(tmp);
+		augment_path(node._data());
 		return node;
 	} 	
 
@@ -811,7 +2241,8 @@ public:
 				elem.Left()._data()->parent = dummy;				
 				dummy->right = elem.Left().GetMax()._data();
 				delete_node(elem._data());
-				return iterator(dummy->right);
+				--tree_size;
+				return iterator(dummy);
 			}
 			else {  //  Удаляем не корень, у которого только левое поддерево
 				iterator rezult(elem);
@@ -829,6 +2260,7 @@ public:
 					elem.Parent()._data()->left = elem.Left()._data();
 				}
 				--tree_size;
+				augment_path(elem._data()->parent);
 				delete_node(elem._data());
 				return rezult;
 			}
@@ -846,7 +2278,7 @@ public:
 			}
 			else {  //  Удаляем не корень, у которого только правое поддерево
 				//  Меняем дочерний
-				iterator rezult(elem.Right());
+				iterator rezult(elem.Right().GetMin());
 
 				elem.Right()._data()->parent = elem.Parent()._data();
 				//if (elem.Parent().Right() == elem) {
@@ -860,6 +2292,7 @@ public:
 						dummy->left = elem.Right().GetMin()._data();
 				}
 				--tree_size;
+				augment_path(elem._data()->parent);
 				delete_node(elem._data());
 				return rezult;
 			}
@@ -867,9 +2300,12 @@ public:
 		//  случай когда есть оба дочерних поддерева		
 		// Вообще можно и в случаях с одним поддеревом использовать swap
 
+		//  Следующий элемент – минимум правого поддерева, перестановка его не затрагивает
+		iterator rezult(elem);
+		++rezult;
 		replace_with_max_left(elem);
-
-		return erase(elem);
+		erase(elem);
+		return rezult;
 	}
 	
 	size_type erase(const value_type& elem) {
@@ -879,62 +2315,467 @@ public:
 		erase(it);
 		return 1;
 	}
+
+	//  Очередь с двумя концами: минимум и максимум хранятся в фиктивной вершине, поэтому top_min/top_max – O(1).
+	//    pop_min/pop_max вырезают крайний узел сразу: у минимума нет левого поддерева, у максимума – правого,
+	//    так что ни поиска, ни перестановки узлов (replace_with_max_left) не нужно. Дерево не должно быть пустым
+	const T& top_min() const noexcept
+	{
+		assert(!empty());
+		return dummy->left->data;
+	}
+
+	const T& top_max() const noexcept
+	{
+		assert(!empty());
+		return dummy->right->data;
+	}
+
+	void pop_min()
+	{
+		assert(!empty());
+		Node* node = dummy->left;
+		unlink_node(node);
+		delete_node(node);
+	}
+
+	void pop_max()
+	{
+		assert(!empty());
+		Node* node = dummy->right;
+		unlink_node(node);
+		delete_node(node);
+	}
+
+	//  Замена ключа элемента position на key без перевыделения узла (например, перенос срока таймера). Если ключ
+	//    остаётся между соседями, он заменяется на месте; иначе узел вырезается и подвешивается на новое место
+	//    спуском от корня, итераторы на него остаются действительными. Если другой элемент уже имеет такой ключ,
+	//    ничего не меняется и возвращается {итератор на этот элемент, false}
+	std::pair<iterator, bool> update_key(const_iterator position, const T& key)
+	{
+		Node* node = position.data;
+		iterator prev(position), next(position);
+		--prev;
+		++next;
+		if ((prev.isNil() || less(*prev, key)) && (next.isNil() || less(key, *next))) {
+			node->data = key;
+			if constexpr (Prefix::enabled)
+				node->prefix = Prefix::make(node->data);
+			augment_path(node);
+			return std::make_pair(iterator(node), true);
+		}
+		iterator existing = find(key);
+		if (existing.notNil())
+			return std::make_pair(existing, false);
+
+		//  Копия до изменения дерева: если копирование бросит исключение, дерево останется прежним
+		T value(key);
+		stats().relinked();
+		if (node->left != dummy && node->right != dummy)
+			replace_with_max_left(iterator(node));
+		unlink_node(node);
+		node->data = std::move(value);
+		if constexpr (Prefix::enabled)
+			node->prefix = Prefix::make(node->data);
+
+		stats().lookup();
+		const key_prefix kp = Prefix::make(node->data);
+		Node* parent = dummy;
+		bool to_left = true;
+		for (Node* current = dummy->parent; current != dummy; current = to_left ? current->left : current->right) {
+			parent = current;
+			to_left = less(node->data, kp, current);
+		}
+		attach_node(node, parent, to_left);
+		return std::make_pair(iterator(node), true);
+	}
+
+private:
+	//  Вырезание узла, у которого не больше одного дочернего: дочерний встаёт на его место. Сам узел не удаляется
+	void unlink_node(Node* node)
+	{
+		Node* parent = node->parent;
+		Node* child = node->left != dummy ? node->left : node->right;
+		//  У минимума нет левого поддерева: следующий – минимум правого или родитель. Для максимума – симметрично
+		if (dummy->left == node)
+			dummy->left = node->right != dummy ? leftmost(node->right) : parent;
+		if (dummy->right == node)
+			dummy->right = node->left != dummy ? iterator(node->left).GetMax()._data() : parent;
+		if (parent == dummy)
+			dummy->parent = child;
+		else if (parent->left == node)
+			parent->left = child;
+		else
+			parent->right = child;
+		if (child != dummy)
+			child->parent = parent;
+		--tree_size;
+		augment_path(parent);
+	}
+
+public:
 	
-	//  Проверить!!!
+	//  Удаление диапазона [first, last) за O(h + k): дерево разрезается по границам диапазона на три части,
+	//    крайние части склеиваются обратно, а средняя удаляется целиком, без поэлементных перестановок узлов
 	iterator erase(const_iterator first, const_iterator last) {
-		while (first != last)
-			first = erase(first);
+		if (first == last) return last;
+		Node* middle = detach_range(first, last);
+		size_type count = free_subtree(Alc, middle, dummy);
+		stats().freed(count);
+		tree_size -= count;
 		return last;
 	}
 
-	//Если передавать по ссылкам,все хорошо. Конструктор копий принескольких деревьях ломается.
-	friend bool operator== (const Binary_Search_Tree<T> &tree_1, const Binary_Search_Tree<T> & tree_2)
-	{
-		auto i = tree_1.begin(), ii = tree_2.begin();
-		for (; (i != tree_1.end()) && (ii != tree_2.end()); ++i, ++ii)
-		{
-			if (*i != *ii)
-				return false;
+	//  То же, что erase(first, last), но узлы средней части пересчитываются и освобождаются в отсоединённом
+	//    фоновом потоке: вызывающий поток тратит только O(h) на разрезание дерева. Дерево изменяется сразу,
+	//    а фоновый поток работает только с отрезанными узлами, поэтому дерево можно использовать, не дожидаясь
+	//    его окончания. Число удалённых элементов известно только фоновому потоку, поэтому size() и операции,
+	//    которым нужен размер, дождутся его; поиск, вставка, удаление и обход не ждут.
+	//    Возвращаемый future даёт число удалённых элементов; его можно не сохранять – поток не привязан к нему.
+	//  Только для аллокаторов без состояния – узлы освобождает копия аллокатора в другом потоке
+	std::shared_future<size_type> erase_deferred(const_iterator first, const_iterator last) {
+		static_assert(std::allocator_traits<AllocType>::is_always_equal::value,
+			"erase_deferred requires a stateless (thread-safe) allocator");
+		std::promise<size_type> freed;
+		std::shared_future<size_type> result = freed.get_future().share();
+		if (first == last) {
+			freed.set_value(0);
+			return result;
+		}
+		//  Всё, что может бросить исключение, – до разрезания дерева
+		if (!deferred) deferred = std::make_unique<Deferred_Erase>();
+		deferred->pending.reserve(deferred->pending.size() + 1);
+		Node* middle = detach_range(first, last);
+		try {
+			//  Фиктивная вершина используется фоновым потоком только как значение-маркер, не разыменовывается
+			std::thread([alc = Alc, middle, nil = dummy, freed = std::move(freed)]() mutable {
+				freed.set_value(free_subtree(alc, middle, nil));
+			}).detach();
+		}
+		catch (const std::system_error&) {
+			//  Поток не создан – узлы освобождаются здесь же
+			std::promise<size_type> done;
+			size_type count = free_subtree(Alc, middle, dummy);
+			stats().freed(count);
+			tree_size -= count;
+			done.set_value(count);
+			return done.get_future().share();
 		}
-		return i == tree_1.end() && ii == tree_2.end();
+		std::lock_guard<std::mutex> guard(deferred->lock);
+		deferred->pending.push_back(result);
+		return result;
 	}
 
 	//  Очистка дерева (без удаления фиктивной вершины)
 	void clear() {
-		Free_nodes(dummy->parent);
+		stats().freed(free_subtree(Alc, dummy->parent, dummy));
+		drop_deferred();
 		tree_size = 0;
 		dummy->parent = dummy->left = dummy->right = dummy;
 	}
 
+	//  Запись двоичного снимка (формат описан у Tree_Snapshot_Header). Только для тривиально копируемых ключей.
+	//    with_shape – сохранить и форму дерева, чтобы load восстановил её в точности; без неё load строит
+	//    идеально сбалансированное дерево. Возвращает false при ошибке записи
+	bool save(const std::string & path, bool with_shape = false) const
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "snapshots require trivially copyable keys");
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		if (!out) return false;
+
+		char header_block[Tree_Snapshot_Header::keys_offset] = {};
+		Tree_Snapshot_Header header;
+		std::memcpy(header.magic, Tree_Snapshot_Header::signature, sizeof(header.magic));
+		header.version = Tree_Snapshot_Header::current_version;
+		header.key_size = sizeof(T);
+		header.flags = with_shape ? Tree_Snapshot_Header::has_shape : 0;
+		settle_deferred();
+		header.count = tree_size;
+		std::memcpy(header_block, &header, sizeof(header));
+		out.write(header_block, sizeof(header_block));
+
+		for (iterator it = begin(); it != end(); ++it)
+			out.write(reinterpret_cast<const char*>(&*it), sizeof(T));
+
+		if (with_shape) {
+			//  Прямой обход без стека – по ссылкам на родителей
+			unsigned char packed = 0;
+			size_type written = 0;
+			Node* current = dummy->parent;
+			while (current != dummy) {
+				unsigned bits = (current->left != dummy ? 1u : 0u) | (current->right != dummy ? 2u : 0u);
+				packed |= bits << (2 * (written % 4));
+				if (++written % 4 == 0) {
+					out.put(static_cast<char>(packed));
+					packed = 0;
+				}
+				if (current->left != dummy)
+					current = current->left;
+				else if (current->right != dummy)
+					current = current->right;
+				else {
+					//  Поднимаемся, пока не окажемся в левом поддереве узла, у которого есть правое
+					Node* parent = current->parent;
+					while (parent != dummy && (parent->right == current || parent->right == dummy)) {
+						current = parent;
+						parent = parent->parent;
+					}
+					current = parent != dummy ? parent->right : dummy;
+				}
+			}
+			if (written % 4 != 0)
+				out.put(static_cast<char>(packed));
+		}
+		return static_cast<bool>(out.flush());
+	}
+
+	//  Загрузка двоичного снимка вместо текущего содержимого за O(n): без спусков от корня и без сравнений,
+	//    кроме проверки упорядоченности. При ошибке (файл не читается, не тот формат, ключи не упорядочены)
+	//    возвращает false, дерево при этом остаётся пустым
+	bool load(const std::string & path)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "snapshots require trivially copyable keys");
+		clear();
+		std::ifstream in(path, std::ios::binary);
+		if (!in) return false;
+
+		char header_block[Tree_Snapshot_Header::keys_offset];
+		Tree_Snapshot_Header header;
+		if (!in.read(header_block, sizeof(header_block))) return false;
+		std::memcpy(&header, header_block, sizeof(header));
+		if (!header.valid(sizeof(T))) return false;
+
+		//  Число ключей из заголовка проверяется по длине файла до выделения памяти: у обрезанного
+		//    или повреждённого снимка оно может быть любым
+		std::streamoff keys_end = in.seekg(0, std::ios::end).tellg();
+		if (!in || keys_end < static_cast<std::streamoff>(Tree_Snapshot_Header::keys_offset) ||
+			header.count > static_cast<std::uint64_t>(keys_end - Tree_Snapshot_Header::keys_offset) / sizeof(T) ||
+			!in.seekg(Tree_Snapshot_Header::keys_offset))
+			return false;
+
+		std::vector<T> keys(static_cast<size_t>(header.count));
+		if (!in.read(reinterpret_cast<char*>(keys.data()), keys.size() * sizeof(T))) return false;
+		for (size_t i = 1; i < keys.size(); ++i)
+			if (!cmp(keys[i - 1], keys[i])) return false;
+
+		if (!(header.flags & Tree_Snapshot_Header::has_shape)) {
+			build_from_sorted(keys.data(), keys.data() + keys.size());
+			return true;
+		}
+
+		std::vector<unsigned char> shape((keys.size() + 3) / 4);
+		if (!in.read(reinterpret_cast<char*>(shape.data()), shape.size())) return false;
+		return build_from_shape(keys, shape);
+	}
+
 private:
-	//  Рекурсивное удаление узлов дерева, не включая фиктивную вершину
-	void Free_nodes(Node* node)
-	{ 
-		if (node != dummy)
-		{
-			Free_nodes(node->left);
-			Free_nodes(node->right);
-			delete_node(node);
+	//  Восстановление дерева заданной формы (см. Tree_Snapshot_Header). Прямой обход формы моделируется стеком:
+	//    узел получает очередной ключ по порядку, когда построено его левое поддерево
+	bool build_from_shape(const std::vector<T> & keys, const std::vector<unsigned char> & shape)
+	{
+		if (keys.empty()) return true;
+		struct Frame {
+			unsigned bits;
+			Node* node;  //  nullptr – ждём левое поддерево, иначе ждём правое поддерево узла node
+		};
+		std::vector<Frame> stack;
+		std::vector<Node*> created;
+		created.reserve(keys.size());
+		size_type preorder = 0, inorder = 0;
+		auto next_bits = [&]() { unsigned bits = (shape[preorder / 4] >> (2 * (preorder % 4))) & 3u; ++preorder; return bits; };
+
+		Node* result = dummy;
+		bool descend = true;
+		unsigned bits = next_bits();
+		for (;;) {
+			if (descend) {
+				//  Спуск по левым поддеревьям
+				while (bits & 1u) {
+					stack.push_back(Frame{ bits, nullptr });
+					if (preorder == keys.size()) break;
+					bits = next_bits();
+				}
+				if ((bits & 1u) || inorder == keys.size()) break;  //  форма повреждена
+				result = dummy;
+			}
+			else {
+				if (stack.empty()) break;
+				Frame frame = stack.back();
+				stack.pop_back();
+				if (frame.node != nullptr) {
+					//  Правое поддерево frame.node построено
+					frame.node->right = result;
+					result->parent = frame.node;
+					result = frame.node;
+					continue;
+				}
+				bits = frame.bits;
+				if (inorder == keys.size()) break;
+			}
+			//  Левое поддерево построено (в result) – создаём узел
+			Node* current = make_node(keys[inorder++], nullptr, result, dummy);
+			created.push_back(current);
+			if (result != dummy) result->parent = current;
+			if (bits & 2u) {
+				stack.push_back(Frame{ bits, current });
+				if (preorder == keys.size()) break;
+				bits = next_bits();
+				descend = true;
+				continue;
+			}
+			result = current;
+			descend = false;
 		}
+
+		if (!stack.empty() || inorder != keys.size() || preorder != keys.size()) {
+			for (Node* node : created)
+				delete_node(node);
+			return false;
+		}
+		tree_size = keys.size();
+		dummy->parent = result;
+		result->parent = dummy;
+		dummy->left = created.front();
+		dummy->right = created.back();
+		augment_all();
+		return true;
 	}
-	
+
+private:
+	//  Вырезание диапазона [first, last) из дерева. Дерево разрезается по ключу *first на меньшие и остальные,
+	//    остальные – по ключу *last, после чего меньшие и большие склеиваются. Возвращает корень вырезанного поддерева
+	Node* detach_range(const_iterator first, const_iterator last)
+	{
+		Node* root = dummy->parent;
+		Node* less_part;
+		Node* rest;
+		split_tree(root, *first, less_part, rest);
+
+		Node* middle = rest;
+		Node* greater_part = dummy;
+		if (last != end())
+			split_tree(rest, *last, middle, greater_part);
+
+		root = join_trees(less_part, greater_part);
+		dummy->parent = root;
+		if (root == dummy)
+			dummy->left = dummy->right = dummy;
+		else {
+			root->parent = dummy;
+			dummy->left = iterator(root).GetMin()._data();
+			dummy->right = iterator(root).GetMax()._data();
+		}
+		return middle;
+	}
+
+	//  Разрезание поддерева на две части: ключи меньше key и не меньше key. Проход по одному пути от корня,
+	//    узлы пути раздаются в одну из частей вместе с поддеревьями, которые целиком лежат по нужную сторону.
+	//    Корни частей получают родителем фиктивную вершину
+	void split_tree(Node* root, const T& key, Node*& less_part, Node*& rest)
+	{
+		less_part = rest = dummy;
+		Node** less_hook = &less_part;
+		Node** rest_hook = &rest;
+		Node* less_parent = dummy;
+		Node* rest_parent = dummy;
+		Node* current = root;
+		const key_prefix kp = Prefix::make(key);
+		while (current != dummy) {
+			stats().relinked();
+			if (less(current, key, kp)) {
+				//  Узел и его левое поддерево – в меньшую часть, продолжаем в правом
+				*less_hook = current;
+				current->parent = less_parent;
+				less_parent = current;
+				less_hook = &current->right;
+				current = current->right;
+			}
+			else {
+				*rest_hook = current;
+				current->parent = rest_parent;
+				rest_parent = current;
+				rest_hook = &current->left;
+				current = current->left;
+			}
+		}
+		*less_hook = dummy;
+		*rest_hook = dummy;
+		//  Изменились только узлы пути, и каждый из них – предок последнего узла своей части
+		augment_path(less_parent);
+		augment_path(rest_parent);
+	}
+
+	//  Склейка двух деревьев, где все ключи left меньше ключей right. Максимум левого дерева становится корнем
+	Node* join_trees(Node* left, Node* right)
+	{
+		if (left == dummy) return right;
+		if (right == dummy) return left;
+		Node* max_node = iterator(left).GetMax()._data();
+		stats().relinked();
+		Node* changed = max_node;
+		if (max_node != left) {
+			//  У максимума нет правого поддерева – на его место встаёт левое
+			changed = max_node->parent;
+			max_node->parent->right = max_node->left;
+			if (max_node->left != dummy)
+				max_node->left->parent = max_node->parent;
+			max_node->left = left;
+			left->parent = max_node;
+		}
+		max_node->right = right;
+		right->parent = max_node;
+		max_node->parent = dummy;
+		//  Путь от бывшего родителя максимума идёт через корень left к новому корню
+		augment_path(changed);
+		return max_node;
+	}
+
+	//  Удаление всех узлов поддерева без рекурсии и без дополнительной памяти: пока у узла есть левый
+	//    дочерний, делаем правый поворот, иначе удаляем узел и переходим направо. Возвращает количество удалённых узлов
+	static size_type free_subtree(AllocType & alc, Node* node, const Node* nil)
+	{
+		size_type count = 0;
+		while (node != nil) {
+			if (node->left == nil) {
+				Node* right = node->right;
+				delete_node(alc, node);
+				node = right;
+				++count;
+			}
+			else {
+				Node* left = node->left;
+				node->left = left->right;
+				left->right = node;
+				node = left;
+			}
+		}
+		return count;
+	}
+
 public:
 	~Binary_Search_Tree()
 	{
-		clear(); // рекурсивный деструктор
+		clear();
 		delete_dummy(dummy);
 	}
 };
 
-template <class Key, class Compare, class Allocator>
-void swap(Binary_Search_Tree<Key, Compare, Allocator>& x, Binary_Search_Tree<Key, Compare, Allocator>& y) noexcept(noexcept(x.swap(y))) {
+//  Дерево с полиморфным аллокатором: узлы и ключи (например, std::pmr::string) размещаются в одном
+//    std::pmr::memory_resource, например, в monotonic_buffer_resource, который освобождается целиком
+namespace pmr {
+	template<typename T, class Compare = std::less<T>, class Stats = No_Tree_Stats, class Augment = No_Tree_Augment>
+	using Binary_Search_Tree = ::Binary_Search_Tree<T, Compare, std::pmr::polymorphic_allocator<T>, Stats, Augment>;
+}
+
+template <class Key, class... Rest>
+void swap(Binary_Search_Tree<Key, Rest...>& x, Binary_Search_Tree<Key, Rest...>& y) noexcept(noexcept(x.swap(y))) {
 	x.swap(y);
 };
 
 
-template <class Key, class Compare, class Allocator>
-bool operator==(const Binary_Search_Tree<Key, Compare, Allocator>& x, const Binary_Search_Tree<Key, Compare, Allocator>& y) {
-	typename Binary_Search_Tree<Key, Compare, Allocator>::const_iterator it1{ x.begin() }, it2{ y.begin() };
+template <class Key, class... Rest>
+bool operator==(const Binary_Search_Tree<Key, Rest...>& x, const Binary_Search_Tree<Key, Rest...>& y) {
+	typename Binary_Search_Tree<Key, Rest...>::const_iterator it1{ x.begin() }, it2{ y.begin() };
 	while (it1 != x.end() && it2 != y.end() && *it1 == *it2) {
 		++it1; ++it2;
 	}
@@ -942,10 +2783,10 @@ bool operator==(const Binary_Search_Tree<Key, Compare, Allocator>& x, const Bina
 	return it1 == x.end() && it2 == y.end();
 }
 
-template <class Key, class Compare, class Allocator>
-bool operator<(const Binary_Search_Tree<Key, Compare, Allocator>& x, const Binary_Search_Tree<Key, Compare, Allocator>& y) {
+template <class Key, class... Rest>
+bool operator<(const Binary_Search_Tree<Key, Rest...>& x, const Binary_Search_Tree<Key, Rest...>& y) {
 	
-	typename Binary_Search_Tree<Key, Compare, Allocator>::const_iterator it1{ x.begin() }, it2{ y.begin() };
+	typename Binary_Search_Tree<Key, Rest...>::const_iterator it1{ x.begin() }, it2{ y.begin() };
 	while (it1 != x.end() && it2 != y.end() && *it1 == *it2) {
 		++it1; ++it2;
 	}
@@ -956,23 +2797,23 @@ bool operator<(const Binary_Search_Tree<Key, Compare, Allocator>& x, const Binar
 	return it2 != y.end() && *it1 < *it2;
 }
 
-template <class Key, class Compare, class Allocator>
-bool operator!=(const Binary_Search_Tree<Key, Compare, Allocator>& x, const Binary_Search_Tree<Key, Compare, Allocator>& y) {
+template <class Key, class... Rest>
+bool operator!=(const Binary_Search_Tree<Key, Rest...>& x, const Binary_Search_Tree<Key, Rest...>& y) {
 	return !(x == y);
 }
 
-template <class Key, class Compare, class Allocator>
-bool operator>(const Binary_Search_Tree<Key, Compare, Allocator>& x, const Binary_Search_Tree<Key, Compare, Allocator>& y) {
+template <class Key, class... Rest>
+bool operator>(const Binary_Search_Tree<Key, Rest...>& x, const Binary_Search_Tree<Key, Rest...>& y) {
 	return y < x;
 }
 
-template <class Key, class Compare, class Allocator>
-bool operator>=(const Binary_Search_Tree<Key, Compare, Allocator>& x, const Binary_Search_Tree<Key, Compare, Allocator>& y) {
+template <class Key, class... Rest>
+bool operator>=(const Binary_Search_Tree<Key, Rest...>& x, const Binary_Search_Tree<Key, Rest...>& y) {
 	return !(x<y);
 }
 
-template <class Key, class Compare, class Allocator>
-bool operator<=(const Binary_Search_Tree<Key, Compare, Allocator>& x, const Binary_Search_Tree<Key, Compare, Allocator>& y) {
+template <class Key, class... Rest>
+bool operator<=(const Binary_Search_Tree<Key, Rest...>& x, const Binary_Search_Tree<Key, Rest...>& y) {
 	return   !(y < x);
 }
 
@@ -0,0 +1,355 @@
+﻿#pragma once
+
+//  Дерево поиска с журналом изменений на диске (только для тривиально копируемых ключей).
+//  Состояние хранится в двух файлах:
+//    <base>.snap – двоичный снимок дерева (Binary_Search_Tree::save), пишется при уплотнении журнала;
+//    <base>.log  – журнал операций insert/erase, сделанных после снимка. Журнал пополняется только в конец
+//                  пачками; у каждой пачки есть заголовок с количеством записей и контрольной суммой.
+//  Операции сразу применяются к дереву в памяти и копятся в буфере. Буфер сбрасывается на диск одной пачкой
+//    с одним fsync (групповая фиксация) – при заполнении или по вызову commit(). Если несколько потоков
+//    одновременно вызвали commit(), то fsync выполняет один из них, остальные дожидаются его результата.
+//  Восстановление после сбоя: снимок загружается за O(n) без спусков от корня, затем проигрываются пачки журнала
+//    до первой повреждённой (недописанной) пачки, хвост журнала после неё отрезается.
+
+#include "BStree.h"
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <filesystem>
+#include <system_error>
+
+#ifdef _WIN32
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+	#include <io.h>
+#else
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+template<typename T, class Compare = std::less<T>, class Allocator = std::allocator<T>>
+class Durable_Search_Tree
+{
+	static_assert(std::is_trivially_copyable<T>::value, "durable trees require trivially copyable keys");
+
+public:
+	using tree_type = Binary_Search_Tree<T, Compare, Allocator>;
+	using value_type = T;
+	using size_type = typename tree_type::size_type;
+
+private:
+	//  Заголовок пачки в журнале
+	struct Batch_Header
+	{
+		std::uint32_t magic;
+		std::uint32_t records;
+		std::uint64_t checksum;
+	};
+	static constexpr std::uint32_t batch_magic = 0x4C545342;  //  "BSTL"
+
+	//  Запись журнала: код операции и ключ
+	enum Operation : unsigned char { Insert = 1, Erase = 2 };
+	static constexpr size_t record_size = 1 + sizeof(T);
+
+	tree_type tree;
+	std::string snapshot_path;
+	std::string log_path;
+	std::FILE* log = nullptr;
+
+	//  Пачка, ещё не записанная в журнал
+	std::vector<char> pending;
+	size_type pending_records = 0;
+
+	//  Размер пачки, при котором она записывается автоматически, и размер журнала, при котором он уплотняется
+	size_type group_size;
+	std::uint64_t compaction_bytes;
+	std::uint64_t log_bytes = 0;
+
+	//  Групповая фиксация: номер последней принятой операции и последней записанной на диск
+	std::mutex lock;
+	std::condition_variable flushed;
+	std::uint64_t appended_seq = 0;
+	std::uint64_t durable_seq = 0;
+	bool flushing = false;
+	bool failed = false;
+
+	//  Контрольная сумма FNV-1a
+	static std::uint64_t checksum(const char* data, size_t size) noexcept
+	{
+		std::uint64_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < size; ++i) {
+			hash ^= static_cast<unsigned char>(data[i]);
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	static bool sync_file(std::FILE* file)
+	{
+		if (std::fflush(file) != 0) return false;
+#ifdef _WIN32
+		return _commit(_fileno(file)) == 0;
+#else
+		return fsync(fileno(file)) == 0;
+#endif
+	}
+
+	//  Сброс на диск каталога, в котором файл был создан или переименован: без этого новая запись каталога
+	//    может не пережить сбой, даже если содержимое файла уже на диске
+	static bool sync_directory(const std::string& path)
+	{
+#ifdef _WIN32
+		(void)path;
+		return true;   //  в Windows каталог записывает MoveFileEx с MOVEFILE_WRITE_THROUGH
+#else
+		std::string directory = std::filesystem::path(path).parent_path().string();
+		int fd = ::open(directory.empty() ? "." : directory.c_str(), O_RDONLY);
+		if (fd < 0) return false;
+		bool synced = fsync(fd) == 0;
+		::close(fd);
+		return synced;
+#endif
+	}
+
+	//  Замена файла to файлом from, устойчивая к сбою: после возврата true на диске уже новое имя
+	static bool durable_rename(const std::string& from, const std::string& to)
+	{
+#ifdef _WIN32
+		return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+		std::error_code error;
+		std::filesystem::rename(from, to, error);
+		return !error && sync_directory(to);
+#endif
+	}
+
+	void append_record(Operation op, const T& value)
+	{
+		size_t offset = pending.size();
+		pending.resize(offset + record_size);
+		pending[offset] = static_cast<char>(op);
+		std::memcpy(pending.data() + offset + 1, &value, sizeof(T));
+		++pending_records;
+		++appended_seq;
+	}
+
+	//  Запись пачки в журнал. Вызывается при захваченном lock, но сам ввод-вывод выполняется без него,
+	//    чтобы другие потоки могли продолжать изменять дерево и копить следующую пачку
+	bool flush_pending(std::unique_lock<std::mutex>& guard)
+	{
+		while (flushing)
+			flushed.wait(guard);
+		if (pending_records == 0) return !failed;
+
+		flushing = true;
+		std::vector<char> batch;
+		batch.swap(pending);
+		Batch_Header header{ batch_magic, static_cast<std::uint32_t>(pending_records), checksum(batch.data(), batch.size()) };
+		pending_records = 0;
+		std::uint64_t batch_seq = appended_seq;
+
+		guard.unlock();
+		bool ok = std::fwrite(&header, sizeof(header), 1, log) == 1 &&
+			std::fwrite(batch.data(), 1, batch.size(), log) == batch.size() &&
+			sync_file(log);
+		guard.lock();
+
+		flushing = false;
+		if (ok) {
+			durable_seq = batch_seq;
+			log_bytes += sizeof(header) + batch.size();
+		}
+		else
+			failed = true;
+		flushed.notify_all();
+		return ok;
+	}
+
+	//  Проигрывание журнала. Возвращает смещение конца последней целой пачки
+	long replay_log()
+	{
+		std::FILE* in = std::fopen(log_path.c_str(), "rb");
+		if (!in) return 0;
+		//  Длина журнала ограничивает число записей пачки ещё до проверки контрольной суммы: заголовок
+		//    недописанной или повреждённой пачки может содержать любое число
+		long log_end = std::fseek(in, 0, SEEK_END) == 0 ? std::ftell(in) : -1;
+		if (log_end < 0 || std::fseek(in, 0, SEEK_SET) != 0) {
+			std::fclose(in);
+			return 0;
+		}
+		long valid_end = 0;
+		Batch_Header header;
+		std::vector<char> batch;
+		while (std::fread(&header, sizeof(header), 1, in) == 1 && header.magic == batch_magic) {
+			long position = std::ftell(in);
+			if (position < 0 || header.records > static_cast<std::uint64_t>(log_end - position) / record_size)
+				break;
+			batch.resize(static_cast<size_t>(header.records) * record_size);
+			if (std::fread(batch.data(), 1, batch.size(), in) != batch.size() ||
+				checksum(batch.data(), batch.size()) != header.checksum)
+				break;
+			for (size_t offset = 0; offset < batch.size(); offset += record_size) {
+				T value;
+				std::memcpy(&value, batch.data() + offset + 1, sizeof(T));
+				if (batch[offset] == Insert)
+					tree.insert(value);
+				else
+					tree.erase(value);
+			}
+			valid_end = std::ftell(in);
+		}
+		std::fclose(in);
+		return valid_end;
+	}
+
+	void close_log()
+	{
+		if (log) std::fclose(log);
+		log = nullptr;
+	}
+
+public:
+	//  group_records – сколько операций копится до автоматической записи пачки,
+	//  compaction_threshold – размер журнала в байтах, после которого commit() уплотняет журнал в снимок (0 – никогда)
+	explicit Durable_Search_Tree(size_type group_records = 256, std::uint64_t compaction_threshold = 64u << 20)
+		: group_size(group_records > 0 ? group_records : 1), compaction_bytes(compaction_threshold) {}
+
+	Durable_Search_Tree(const Durable_Search_Tree&) = delete;
+	Durable_Search_Tree& operator=(const Durable_Search_Tree&) = delete;
+
+	~Durable_Search_Tree()
+	{
+		close();
+	}
+
+	//  Открытие (и восстановление) дерева по базовому имени файлов. Возвращает false при ошибке ввода-вывода
+	bool open(const std::string& base_path)
+	{
+		close();
+		snapshot_path = base_path + ".snap";
+		log_path = base_path + ".log";
+		tree.clear();
+		failed = false;
+
+		std::error_code error;
+		if (std::filesystem::exists(snapshot_path, error) && !tree.load(snapshot_path))
+			return false;
+
+		//  Недописанный хвост журнала отрезаем, чтобы новые пачки шли сразу за последней целой
+		long valid_end = replay_log();
+		if (std::filesystem::exists(log_path, error)) {
+			std::filesystem::resize_file(log_path, static_cast<std::uintmax_t>(valid_end), error);
+			if (error) return false;
+		}
+		log_bytes = static_cast<std::uint64_t>(valid_end);
+
+		//  Журнал мог быть только что создан – его запись в каталоге тоже должна быть на диске
+		log = std::fopen(log_path.c_str(), "ab");
+		if (log && !sync_directory(log_path))
+			close_log();
+		return log != nullptr;
+	}
+
+	bool is_open() const noexcept { return log != nullptr; }
+
+	//  Запись накопленных операций и закрытие файлов
+	void close()
+	{
+		if (!log) return;
+		commit();
+		close_log();
+	}
+
+	bool insert(const T& value)
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		if (!tree.insert(value).second) return false;
+		append_record(Insert, value);
+		if (pending_records >= group_size)
+			flush_pending(guard);
+		return true;
+	}
+
+	bool erase(const T& value)
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		if (tree.erase(value) == 0) return false;
+		append_record(Erase, value);
+		if (pending_records >= group_size)
+			flush_pending(guard);
+		return true;
+	}
+
+	bool contains(const T& value)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		return tree.find(value) != tree.end();
+	}
+
+	size_type size()
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		return tree.size();
+	}
+
+	//  Гарантирует, что все операции, выполненные до вызова, записаны на диск. Если журнал вырос больше порога,
+	//    он уплотняется в снимок. Возвращает false, если запись журнала когда-либо завершилась ошибкой
+	bool commit()
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		if (!log) return false;
+		std::uint64_t my_seq = appended_seq;
+		while (durable_seq < my_seq && !failed)
+			flush_pending(guard);
+		if (failed) return false;
+		if (compaction_bytes != 0 && log_bytes >= compaction_bytes)
+			return compact_locked(guard);
+		return true;
+	}
+
+	//  Уплотнение: запись снимка текущего состояния и очистка журнала
+	bool compact()
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		if (!log) return false;
+		while (durable_seq < appended_seq && !failed)
+			flush_pending(guard);
+		if (failed) return false;
+		return compact_locked(guard);
+	}
+
+	//  Доступ к дереву только для чтения. Не потокобезопасен относительно одновременных изменений
+	const tree_type& view() const noexcept { return tree; }
+
+private:
+	bool compact_locked(std::unique_lock<std::mutex>& guard)
+	{
+		while (flushing)
+			flushed.wait(guard);
+		//  Снимок пишется во временный файл и заменяет старый переименованием. Если сбой произойдёт до очистки
+		//    журнала, то при восстановлении журнал проиграется поверх нового снимка – это безопасно,
+		//    т.к. повторное применение той же последовательности вставок и удалений даёт то же множество
+		std::string temp_path = snapshot_path + ".tmp";
+		if (!tree.save(temp_path)) return false;
+		std::FILE* snapshot = std::fopen(temp_path.c_str(), "rb+");
+		bool synced = snapshot && sync_file(snapshot);
+		if (snapshot) std::fclose(snapshot);
+		if (!synced) return false;
+		if (!durable_rename(temp_path, snapshot_path)) return false;
+
+		close_log();
+		log = std::fopen(log_path.c_str(), "wb");
+		if (!log || !sync_file(log)) {
+			failed = true;
+			return false;
+		}
+		log_bytes = 0;
+		return true;
+	}
+};
@@ -0,0 +1,222 @@
+﻿#pragma once
+
+//  Обёртка над Binary_Search_Tree для конкурентных изменений по схеме flat combining.
+//  Потоки не захватывают дерево сами, а публикуют операции в свои слоты. Поток, которому удалось
+//  захватить дерево (комбинатор), собирает все опубликованные операции, сортирует их по ключу
+//  и применяет одной пачкой. Остальные потоки в это время просто ждут готовности своего слота.
+
+//  Вставка отсортированной пачки идёт через «палец»: если ключ попадает между предыдущим
+//  вставленным элементом и его последователем, то используется insert с подсказкой (без спуска от корня).
+
+#include "BStree.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <exception>
+#include <algorithm>
+
+template<typename T, class Compare = std::less<T>, class Allocator = std::allocator<T>>
+class Flat_Combining_Tree
+{
+public:
+	using tree_type = Binary_Search_Tree<T, Compare, Allocator>;
+	using value_type = T;
+	using size_type = typename tree_type::size_type;
+
+private:
+	//  Вид опубликованной операции
+	enum class Operation : unsigned char { Insert, Erase, Contains };
+
+	//  Состояние слота публикации
+	enum SlotState : int {
+		Free = 0,      //  слот свободен
+		Writing = 1,   //  поток-владелец заполняет операцию
+		Pending = 2,   //  операция опубликована и ждёт комбинатора
+		Done = 3       //  комбинатор выполнил операцию, результат в поле result (или исключение в поле error)
+	};
+
+	//  Слот публикации. Выравниваем по кэш-линии, чтобы соседние потоки не мешали друг другу
+	struct alignas(64) Slot
+	{
+		std::atomic<int> state{ Free };
+		Operation op = Operation::Insert;
+		bool result = false;
+		T value = T();
+		//  Исключение, брошенное операцией этого слота; передаётся опубликовавшему её потоку
+		std::exception_ptr error;
+	};
+
+	tree_type tree;
+	std::unique_ptr<Slot[]> slots;
+	size_type slots_count;
+
+	//  Захват дерева комбинатором
+	std::mutex combiner_lock;
+
+	//  Буфер для сбора пачки – используется только комбинатором, поэтому не перевыделяется каждый раз
+	std::vector<Slot*> batch;
+
+	//  Номер потока – назначается при первом обращении, используется для выбора «своего» слота
+	static size_type thread_index()
+	{
+		static std::atomic<size_type> next_index{ 0 };
+		thread_local size_type index = next_index.fetch_add(1, std::memory_order_relaxed);
+		return index;
+	}
+
+	//  Захват слота. Обычно поток получает свой слот сразу, но если потоков больше, чем слотов,
+	//    то ищем свободный линейным пробированием
+	Slot* acquire_slot()
+	{
+		size_type index = thread_index() % slots_count;
+		for (;;) {
+			for (size_type i = 0; i < slots_count; ++i) {
+				Slot& slot = slots[(index + i) % slots_count];
+				int expected = Free;
+				if (slot.state.load(std::memory_order_relaxed) == Free &&
+					slot.state.compare_exchange_strong(expected, Writing, std::memory_order_acquire))
+					return &slot;
+			}
+			std::this_thread::yield();
+		}
+	}
+
+	void collect_pending()
+	{
+		batch.clear();
+		for (size_type i = 0; i < slots_count; ++i)
+			if (slots[i].state.load(std::memory_order_acquire) == Pending)
+				batch.push_back(&slots[i]);
+	}
+
+	//  Применение всех опубликованных операций. Вызывается только под combiner_lock.
+	//    Не бросает исключений: исключение операции сохраняется в её слоте, а слот всё равно помечается
+	//    выполненным, – иначе опубликовавший его поток ждал бы вечно
+	void combine() noexcept
+	{
+		collect_pending();
+		if (batch.empty()) return;
+
+		//  Сортируем по ключу, порядок операций над одним ключом – в порядке слотов. Если сравнение бросило
+		//    исключение, пачка применяется в порядке слотов: исключение получит операция со «сломанным» ключом
+		Compare cmp = tree.key_comp();
+		try {
+			std::stable_sort(batch.begin(), batch.end(), [&cmp](const Slot* a, const Slot* b) { return cmp(a->value, b->value); });
+		}
+		catch (...) {
+			collect_pending();
+		}
+
+		//  Последний вставленный (или найденный) элемент – «палец» для следующей вставки
+		typename tree_type::iterator finger = tree.end();
+		for (Slot* slot : batch) {
+			try {
+				switch (slot->op) {
+				case Operation::Insert:
+					slot->result = insert_near(finger, slot->value);
+					break;
+				case Operation::Erase:
+					slot->result = tree.erase(slot->value) != 0;
+					//  Удаление могло затронуть узел под пальцем
+					finger = tree.end();
+					break;
+				case Operation::Contains:
+					slot->result = tree.find(slot->value) != tree.end();
+					break;
+				}
+			}
+			catch (...) {
+				slot->error = std::current_exception();
+				finger = tree.end();
+			}
+			slot->state.store(Done, std::memory_order_release);
+		}
+	}
+
+	//  Вставка с использованием пальца: если value лежит строго между finger и следующим за ним элементом,
+	//    то место вставки уже известно, и спуск от корня не нужен
+	bool insert_near(typename tree_type::iterator& finger, const T& value)
+	{
+		Compare cmp = tree.key_comp();
+		if (finger != tree.end() && cmp(*finger, value)) {
+			typename tree_type::iterator next = std::next(finger);
+			if (next == tree.end() || cmp(value, *next)) {
+				size_type old_size = tree.size();
+				finger = tree.insert(next, value);
+				return tree.size() != old_size;
+			}
+		}
+		std::pair<typename tree_type::iterator, bool> res = tree.insert(value);
+		finger = res.first;
+		return res.second;
+	}
+
+	//  Публикация операции и ожидание результата
+	bool execute(Operation op, const T& value)
+	{
+		Slot* slot = acquire_slot();
+		slot->op = op;
+		try {
+			slot->value = value;
+		}
+		catch (...) {
+			slot->state.store(Free, std::memory_order_release);
+			throw;
+		}
+		slot->state.store(Pending, std::memory_order_release);
+
+		while (slot->state.load(std::memory_order_acquire) != Done) {
+			std::unique_lock<std::mutex> guard(combiner_lock, std::try_to_lock);
+			if (guard)
+				combine();
+			else
+				std::this_thread::yield();
+		}
+
+		bool result = slot->result;
+		std::exception_ptr error = std::move(slot->error);
+		slot->error = nullptr;
+		slot->state.store(Free, std::memory_order_release);
+		if (error)
+			std::rethrow_exception(error);
+		return result;
+	}
+
+public:
+	//  slots_number – количество слотов публикации, разумно брать не меньше числа пишущих потоков
+	explicit Flat_Combining_Tree(size_type slots_number = 2 * std::max(1u, std::thread::hardware_concurrency()),
+		Compare comparator = Compare())
+		: tree(comparator), slots(new Slot[slots_number > 0 ? slots_number : 1]), slots_count(slots_number > 0 ? slots_number : 1)
+	{
+		batch.reserve(slots_count);
+	}
+
+	Flat_Combining_Tree(const Flat_Combining_Tree&) = delete;
+	Flat_Combining_Tree& operator=(const Flat_Combining_Tree&) = delete;
+
+	//  Вставка элемента. Возвращает true, если элемента не было в дереве
+	bool insert(const T& value) { return execute(Operation::Insert, value); }
+
+	//  Удаление элемента. Возвращает true, если элемент был в дереве
+	bool erase(const T& value) { return execute(Operation::Erase, value); }
+
+	//  Проверка наличия элемента. Выполняется комбинатором вместе с изменениями
+	bool contains(const T& value) { return execute(Operation::Contains, value); }
+
+	//  Выполнение произвольного действия над деревом при захваченном комбинаторе.
+	//    Перед вызовом f применяются все уже опубликованные операции
+	template<class Function>
+	auto apply(Function f)
+	{
+		std::lock_guard<std::mutex> guard(combiner_lock);
+		combine();
+		return f(tree);
+	}
+
+	size_type size()
+	{
+		return apply([](const tree_type& t) { return t.size(); });
+	}
+};
@@ -0,0 +1,298 @@
+﻿#pragma once
+
+//  Множество на отсортированном непрерывном массиве (flat_set) с тем же интерфейсом, что и у Binary_Search_Tree.
+//    Для наборов, которые часто читаются и редко меняются: поиск – двоичный поиск по массиву без переходов
+//    по указателям, обход – последовательное чтение памяти, на ключ не тратится ни узел, ни три указателя.
+//    Вставка и удаление одного ключа стоят O(n) сдвигов, поэтому пакеты лучше вставлять через insert(first, last):
+//    новые ключи дописываются в конец, сортируются и сливаются с уже имеющимися за O(n + k log k).
+//  Преобразования в Binary_Search_Tree и обратно линейны – ключи с обеих сторон уже упорядочены и без повторов,
+//    поэтому представление можно менять по фазам работы: дерево на время изменений, массив – на время чтения.
+
+#include "BStree.h"
+#include <vector>
+#include <utility>
+#include <iterator>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+#include <initializer_list>
+
+template<typename T, class Compare = std::less<T>, class Allocator = std::allocator<T>>
+class Flat_Search_Tree
+{
+public:
+	using key_type = T;
+	using key_compare = Compare;
+	using value_compare = Compare;
+	using value_type = T;
+	using allocator_type = Allocator;
+	using container_type = std::vector<T, Allocator>;
+	using size_type = size_t;
+	using difference_type = std::ptrdiff_t;
+	using pointer = T *;
+	using const_pointer = const T *;
+	using reference = value_type &;
+	using const_reference = const value_type &;
+	//  Как и в дереве, ключи изменять через итератор нельзя – это нарушило бы порядок
+	using iterator = typename container_type::const_iterator;
+	using const_iterator = iterator;
+	using reverse_iterator = std::reverse_iterator<iterator>;
+	using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+	using tree_type = Binary_Search_Tree<T, Compare, Allocator>;
+
+private:
+	Compare cmp;
+	container_type keys;
+
+	//  Сортировка и удаление повторов после произвольного заполнения; для уже упорядоченных ключей – O(n)
+	void sort_unique()
+	{
+		if (!std::is_sorted(keys.begin(), keys.end(), cmp))
+			std::sort(keys.begin(), keys.end(), cmp);
+		remove_duplicates(keys.begin());
+	}
+
+	//  Удаление повторов начиная с from; из равных ключей остаётся первый
+	void remove_duplicates(typename container_type::iterator from)
+	{
+		auto equal = [this](const T& a, const T& b) { return !cmp(a, b); };
+		keys.erase(std::unique(from, keys.end(), equal), keys.end());
+	}
+
+	template<class Function>
+	static bool invoke_visitor(Function& f, const T& key)
+	{
+		if constexpr (std::is_same_v<std::invoke_result_t<Function&, const T&>, bool>)
+			return static_cast<bool>(f(key));
+		else {
+			f(key);
+			return true;
+		}
+	}
+
+public:
+	Flat_Search_Tree(const Compare& comparator = Compare(), const Allocator& alloc = Allocator())
+		: cmp(comparator), keys(alloc) {}
+
+	explicit Flat_Search_Tree(const Allocator& alloc)
+		: Flat_Search_Tree(Compare(), alloc) {}
+
+	Flat_Search_Tree(std::initializer_list<T> il, const Compare& comparator = Compare(), const Allocator& alloc = Allocator())
+		: Flat_Search_Tree(il.begin(), il.end(), comparator, alloc) {}
+
+	Flat_Search_Tree(std::initializer_list<T> il, const Allocator& alloc)
+		: Flat_Search_Tree(il.begin(), il.end(), Compare(), alloc) {}
+
+	template <class InputIterator>
+	Flat_Search_Tree(InputIterator first, InputIterator last, const Compare& comparator = Compare(), const Allocator& alloc = Allocator())
+		: cmp(comparator), keys(first, last, alloc)
+	{
+		sort_unique();
+	}
+
+	template <class InputIterator>
+	Flat_Search_Tree(InputIterator first, InputIterator last, const Allocator& alloc)
+		: Flat_Search_Tree(first, last, Compare(), alloc) {}
+
+	//  Готовый массив ключей забирается без копирования; если он уже упорядочен, сортировки не будет
+	explicit Flat_Search_Tree(container_type source, const Compare& comparator = Compare())
+		: cmp(comparator), keys(std::move(source))
+	{
+		sort_unique();
+	}
+
+	//  Из дерева – за O(n): ключи обходятся по возрастанию и копируются подряд
+	template<class Stats, class Augment>
+	explicit Flat_Search_Tree(const Binary_Search_Tree<T, Compare, Allocator, Stats, Augment>& tree)
+		: cmp(tree.key_comp()), keys(tree.get_allocator())
+	{
+		keys.reserve(tree.size());
+		keys.insert(keys.end(), tree.begin(), tree.end());
+	}
+
+	Flat_Search_Tree(const Flat_Search_Tree&) = default;
+	Flat_Search_Tree(Flat_Search_Tree&&) = default;
+	Flat_Search_Tree& operator=(const Flat_Search_Tree&) = default;
+	Flat_Search_Tree& operator=(Flat_Search_Tree&&) = default;
+
+	Flat_Search_Tree& operator=(std::initializer_list<T> il)
+	{
+		keys.assign(il.begin(), il.end());
+		sort_unique();
+		return *this;
+	}
+
+	//  В дерево – за O(n): упорядоченный массив без повторов сразу строится в идеально сбалансированное дерево.
+	//    Для временного объекта ключи перемещаются, а не копируются
+	template<class Tree = tree_type>
+	Tree to_tree() const &
+	{
+		return Tree(keys.begin(), keys.end(), cmp, keys.get_allocator());
+	}
+
+	template<class Tree = tree_type>
+	Tree to_tree() &&
+	{
+		Tree tree(std::make_move_iterator(keys.begin()), std::make_move_iterator(keys.end()), cmp, keys.get_allocator());
+		keys.clear();
+		return tree;
+	}
+
+	//  Упорядоченный массив ключей – для передачи в алгоритмы и функции, работающие с непрерывной памятью
+	const container_type& sequence() const noexcept { return keys; }
+
+	//  Отдаёт массив ключей, оставляя множество пустым
+	container_type extract() &&
+	{
+		container_type result(std::move(keys));
+		keys.clear();
+		return result;
+	}
+
+	allocator_type get_allocator() const noexcept { return keys.get_allocator(); }
+	key_compare key_comp() const noexcept { return cmp; }
+	value_compare value_comp() const noexcept { return cmp; }
+
+	iterator begin() const noexcept { return keys.cbegin(); }
+	iterator end() const noexcept { return keys.cend(); }
+	const_iterator cbegin() const noexcept { return keys.cbegin(); }
+	const_iterator cend() const noexcept { return keys.cend(); }
+	reverse_iterator rbegin() const noexcept { return reverse_iterator(end()); }
+	reverse_iterator rend() const noexcept { return reverse_iterator(begin()); }
+
+	bool empty() const noexcept { return keys.empty(); }
+	size_type size() const noexcept { return keys.size(); }
+	size_type max_size() const noexcept { return keys.max_size(); }
+	size_type capacity() const noexcept { return keys.capacity(); }
+	void reserve(size_type count) { keys.reserve(count); }
+	void shrink_to_fit() { keys.shrink_to_fit(); }
+
+	void swap(Flat_Search_Tree & other) noexcept
+	{
+		using std::swap;
+		swap(cmp, other.cmp);
+		keys.swap(other.keys);
+	}
+
+	std::pair<iterator, bool> insert(const T & value)
+	{
+		auto position = std::lower_bound(keys.begin(), keys.end(), value, cmp);
+		if (position != keys.end() && !cmp(value, *position))
+			return std::make_pair(iterator(position), false);
+		return std::make_pair(iterator(keys.insert(position, value)), true);
+	}
+
+	std::pair<iterator, bool> insert(T && value)
+	{
+		auto position = std::lower_bound(keys.begin(), keys.end(), value, cmp);
+		if (position != keys.end() && !cmp(value, *position))
+			return std::make_pair(iterator(position), false);
+		return std::make_pair(iterator(keys.insert(position, std::move(value))), true);
+	}
+
+	//  Если x должен стоять прямо перед position, поиск не выполняется
+	iterator insert(const_iterator position, const value_type& x)
+	{
+		if ((position == end() || cmp(x, *position)) && (position == begin() || cmp(*std::prev(position), x)))
+			return keys.insert(position, x);
+		return insert(x).first;
+	}
+
+	template<class... Args>
+	std::pair<iterator, bool> emplace(Args&&... args)
+	{
+		return insert(T(std::forward<Args>(args)...));
+	}
+
+	//  Пакетная вставка: ключи дописываются в конец, сортируются и сливаются с прежними. Слияние устойчиво,
+	//    поэтому из равных ключей остаётся прежний, как и при поштучной вставке
+	template <class InputIterator>
+	void insert(InputIterator first, InputIterator last)
+	{
+		size_type old_size = keys.size();
+		keys.insert(keys.end(), first, last);
+		auto middle = keys.begin() + old_size;
+		if (middle == keys.end()) return;
+		std::stable_sort(middle, keys.end(), cmp);
+		//  Если новые ключи не меньше всех прежних, слияние не нужно и повторы возможны только с последнего прежнего
+		if (old_size == 0)
+			remove_duplicates(keys.begin());
+		else if (!cmp(*middle, *std::prev(middle)))
+			remove_duplicates(std::prev(middle));
+		else {
+			std::inplace_merge(keys.begin(), middle, keys.end(), cmp);
+			remove_duplicates(keys.begin());
+		}
+	}
+
+	void insert(std::initializer_list<T> il) { insert(il.begin(), il.end()); }
+
+	iterator find(const value_type& value) const
+	{
+		iterator position = lower_bound(value);
+		return position != end() && !cmp(value, *position) ? position : end();
+	}
+
+	//  Первый элемент, не меньший key
+	const_iterator lower_bound(const value_type& key) const
+	{
+		return std::lower_bound(keys.begin(), keys.end(), key, cmp);
+	}
+
+	//  Первый элемент, больший key
+	const_iterator upper_bound(const value_type& key) const
+	{
+		return std::upper_bound(keys.begin(), keys.end(), key, cmp);
+	}
+
+	size_type count(const value_type& key) const { return find(key) != end() ? 1 : 0; }
+	bool contains(const value_type& key) const { return find(key) != end(); }
+
+	std::pair<const_iterator, const_iterator> equal_range(const value_type& key) const
+	{
+		const_iterator first = lower_bound(key);
+		if (first == end() || cmp(key, *first))
+			return std::make_pair(first, first);
+		return std::make_pair(first, std::next(first));
+	}
+
+	//  Обход по возрастанию, как в Binary_Search_Tree::for_each: f может вернуть false, чтобы остановить обход
+	template<class Function>
+	bool for_each(Function f) const
+	{
+		for (const T& key : keys)
+			if (!invoke_visitor(f, key)) return false;
+		return true;
+	}
+
+	//  Обход ключей из [lo, hi]
+	template<class Function>
+	bool for_each_in_range(const T& lo, const T& hi, Function f) const
+	{
+		for (iterator it = lower_bound(lo); it != end() && !cmp(hi, *it); ++it)
+			if (!invoke_visitor(f, *it)) return false;
+		return true;
+	}
+
+	iterator erase(const_iterator elem) { return keys.erase(elem); }
+
+	size_type erase(const value_type& elem)
+	{
+		iterator position = find(elem);
+		if (position == end()) return 0;
+		keys.erase(position);
+		return 1;
+	}
+
+	iterator erase(const_iterator first, const_iterator last) { return keys.erase(first, last); }
+
+	void clear() noexcept { keys.clear(); }
+
+	friend bool operator==(const Flat_Search_Tree& x, const Flat_Search_Tree& y) { return x.keys == y.keys; }
+	friend bool operator!=(const Flat_Search_Tree& x, const Flat_Search_Tree& y) { return !(x == y); }
+	friend bool operator<(const Flat_Search_Tree& x, const Flat_Search_Tree& y) { return x.keys < y.keys; }
+	friend bool operator>(const Flat_Search_Tree& x, const Flat_Search_Tree& y) { return y < x; }
+	friend bool operator<=(const Flat_Search_Tree& x, const Flat_Search_Tree& y) { return !(y < x); }
+	friend bool operator>=(const Flat_Search_Tree& x, const Flat_Search_Tree& y) { return !(x < y); }
+	friend void swap(Flat_Search_Tree& x, Flat_Search_Tree& y) noexcept { x.swap(y); }
+};
@@ -0,0 +1,165 @@
+﻿#pragma once
+
+//  Дерево интервалов поверх Binary_Search_Tree. Интервалы [start, end) упорядочены по началу (при равных
+//    началах – по концу), а в каждом узле политика дополнения Interval_Max_End хранит максимальный конец
+//    интервалов поддерева. Дерево само поддерживает эти значения при вставке, удалении и перестановках узлов.
+//  По максимальному концу поиск отбрасывает поддеревья, в которых все интервалы кончаются до точки запроса,
+//    а по порядку начал – всё, что начинается после неё. Запрос, возвращающий k интервалов, проходит O(h + k*h)
+//    узлов в худшем случае, где h – высота дерева; обычно – близко к O(h + k).
+//  Одинаковые интервалы хранятся один раз, как и любые эквивалентные ключи в дереве.
+
+#include "BStree.h"
+#include <vector>
+#include <iterator>
+#include <algorithm>
+#include <functional>
+
+//  Полуоткрытый интервал [start, end)
+template<typename P>
+struct Interval
+{
+	P start;
+	P end;
+
+	friend bool operator==(const Interval& a, const Interval& b) { return a.start == b.start && a.end == b.end; }
+	friend bool operator!=(const Interval& a, const Interval& b) { return !(a == b); }
+};
+
+//  Порядок интервалов в дереве: по началу, затем по концу. cmp – порядок на точках
+template<typename P, class Compare = std::less<P>>
+struct Interval_Order
+{
+	Compare cmp = Compare();
+
+	bool operator()(const Interval<P>& a, const Interval<P>& b) const
+	{
+		if (cmp(a.start, b.start)) return true;
+		if (cmp(b.start, a.start)) return false;
+		return cmp(a.end, b.end);
+	}
+};
+
+//  Политика дополнения узлов (см. No_Tree_Augment): максимальный конец интервалов в поддереве
+template<typename P, class Compare = std::less<P>>
+struct Interval_Max_End
+{
+	static constexpr bool enabled = true;
+	using value_type = P;
+
+	static void update(const Interval_Order<P, Compare>& order, P& max_end, const Interval<P>& key, const P* left, const P* right)
+	{
+		max_end = key.end;
+		if (left && order.cmp(max_end, *left)) max_end = *left;
+		if (right && order.cmp(max_end, *right)) max_end = *right;
+	}
+};
+
+template<typename P, class Compare = std::less<P>, class Allocator = std::allocator<Interval<P>>, class Stats = No_Tree_Stats>
+class Interval_Search_Tree
+	: public Binary_Search_Tree<Interval<P>, Interval_Order<P, Compare>, Allocator, Stats, Interval_Max_End<P, Compare>>
+{
+	using tree_type = Binary_Search_Tree<Interval<P>, Interval_Order<P, Compare>, Allocator, Stats, Interval_Max_End<P, Compare>>;
+	using Node = typename tree_type::Node;
+	using Traversal_Stack = typename tree_type::Traversal_Stack;
+
+public:
+	using interval_type = Interval<P>;
+	using point_type = P;
+
+	using tree_type::tree_type;
+
+	//  Вызов f(const Interval<P>&) для всех интервалов, содержащих точку (start <= point < end), по возрастанию.
+	//    Как и в for_each, f может вернуть false, чтобы остановить поиск; тогда результат – false
+	template<class Function>
+	bool for_each_containing(const P& point, Function f) const
+	{
+		const Compare& cmp = this->comparator().cmp;
+		return visit_ending_after(point, [&cmp, &point](const P& start) { return !cmp(point, start); }, f);
+	}
+
+	std::vector<interval_type> containing(const P& point) const
+	{
+		std::vector<interval_type> result;
+		for_each_containing(point, [&result](const interval_type& interval) { result.push_back(interval); });
+		return result;
+	}
+
+	//  Вызов f для всех интервалов, пересекающихся с [lo, hi) (start < hi и lo < end), по возрастанию
+	template<class Function>
+	bool for_each_overlapping(const P& lo, const P& hi, Function f) const
+	{
+		const Compare& cmp = this->comparator().cmp;
+		if (!cmp(lo, hi)) return true;
+		return visit_ending_after(lo, [&cmp, &hi](const P& start) { return cmp(start, hi); }, f);
+	}
+
+	std::vector<interval_type> overlapping(const P& lo, const P& hi) const
+	{
+		std::vector<interval_type> result;
+		for_each_overlapping(lo, hi, [&result](const interval_type& interval) { result.push_back(interval); });
+		return result;
+	}
+
+	//  Пакетный поиск для точек [first, last), отсортированных по возрастанию: f(const P& point, const Interval<P>&)
+	//    вызывается для каждой пары «точка – содержащий её интервал». Дерево проходится один раз по возрастанию
+	//    начал: точки левее начала очередного интервала не могут попасть ни в него, ни в следующие, поэтому
+	//    поддерево отбрасывается, если его максимальный конец не дальше первой ещё возможной точки
+	template<class ForwardIterator, class Function>
+	bool for_each_containing_sorted(ForwardIterator first, ForwardIterator last, Function f) const
+	{
+		if (first == last) return true;
+		const Compare& cmp = this->comparator().cmp;
+		const Node* nil = this->dummy;
+		this->stats().lookup();
+		Traversal_Stack stack;
+		const Node* node = nil->parent;
+		for (;;) {
+			for (; node != nil && cmp(*first, node->augment); node = node->left)
+				stack.push(node);
+			if (stack.empty()) return true;
+			node = stack.pop();
+			const interval_type& interval = node->data;
+			while (first != last && cmp(*first, interval.start))
+				++first;
+			if (first == last) return true;
+			ForwardIterator stop = std::lower_bound(first, last, interval.end, cmp);
+			for (ForwardIterator point = first; point != stop; ++point)
+				if (!invoke_pair_visitor(f, *point, interval)) return false;
+			node = node->right;
+		}
+	}
+
+private:
+	//  Симметричный обход интервалов с концом правее lo, пока начало удовлетворяет start_fits (условие
+	//    «не правее границы запроса» – если оно нарушено, то нарушено и для всех следующих интервалов)
+	template<class StartFits, class Function>
+	bool visit_ending_after(const P& lo, StartFits start_fits, Function& f) const
+	{
+		const Compare& cmp = this->comparator().cmp;
+		const Node* nil = this->dummy;
+		this->stats().lookup();
+		Traversal_Stack stack;
+		const Node* node = nil->parent;
+		for (;;) {
+			//  Поддерево, где все интервалы кончаются не правее lo, пропускается целиком
+			for (; node != nil && cmp(lo, node->augment); node = node->left)
+				stack.push(node);
+			if (stack.empty()) return true;
+			node = stack.pop();
+			if (!start_fits(node->data.start)) return true;
+			if (cmp(lo, node->data.end) && !tree_type::invoke_visitor(f, node->data)) return false;
+			node = node->right;
+		}
+	}
+
+	template<class Function>
+	static bool invoke_pair_visitor(Function& f, const P& point, const interval_type& interval)
+	{
+		if constexpr (std::is_same_v<std::invoke_result_t<Function&, const P&, const interval_type&>, bool>)
+			return static_cast<bool>(f(point, interval));
+		else {
+			f(point, interval);
+			return true;
+		}
+	}
+};
@@ -0,0 +1,201 @@
+﻿#pragma once
+
+//  Дерево поиска «только для чтения» поверх двоичного снимка Binary_Search_Tree::save, отображённого в память.
+//  Узлы не создаются: отсортированный массив ключей в файле сам по себе является неявным сбалансированным деревом,
+//    поиск – двоичный по этому массиву, итераторы – указатели на ключи в отображённых страницах.
+//  Открытие файла не читает его целиком – страницы подгружаются операционной системой по мере обращения,
+//    поэтому «запуск» с готовым снимком практически мгновенный. Форма дерева (если сохранена) игнорируется.
+
+#include "BStree.h"
+#include <string>
+#include <utility>
+#include <algorithm>
+#include <functional>
+
+#ifdef _WIN32
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+template<typename T, class Compare = std::less<T>>
+class Mapped_Search_Tree
+{
+	static_assert(std::is_trivially_copyable<T>::value, "mapped snapshots require trivially copyable keys");
+
+	Compare cmp = Compare();
+
+	//  Отображение файла
+	const char* mapping = nullptr;
+	size_t mapping_size = 0;
+#ifdef _WIN32
+	HANDLE file_handle = INVALID_HANDLE_VALUE;
+	HANDLE mapping_handle = nullptr;
+#endif
+
+	//  Ключи внутри отображения
+	const T* keys = nullptr;
+	size_t keys_count = 0;
+
+public:
+	using key_type = T;
+	using value_type = T;
+	using key_compare = Compare;
+	using value_compare = Compare;
+	using size_type = size_t;
+	using difference_type = std::ptrdiff_t;
+	using const_reference = const T&;
+	using const_pointer = const T*;
+	//  Ключи неизменяемы, поэтому оба итератора – указатели на константу
+	using iterator = const T*;
+	using const_iterator = const T*;
+	using reverse_iterator = std::reverse_iterator<const_iterator>;
+	using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+	Mapped_Search_Tree(Compare comparator = Compare()) : cmp(comparator) {}
+
+	explicit Mapped_Search_Tree(const std::string& path, Compare comparator = Compare()) : cmp(comparator)
+	{
+		open(path);
+	}
+
+	Mapped_Search_Tree(const Mapped_Search_Tree&) = delete;
+	Mapped_Search_Tree& operator=(const Mapped_Search_Tree&) = delete;
+
+	~Mapped_Search_Tree()
+	{
+		close();
+	}
+
+	//  Отображение снимка в память. Возвращает false, если файл не открывается или имеет неверный формат
+	bool open(const std::string& path)
+	{
+		close();
+		if (!map_file(path)) return false;
+
+		Tree_Snapshot_Header header;
+		if (mapping_size < Tree_Snapshot_Header::keys_offset) {
+			close();
+			return false;
+		}
+		std::memcpy(&header, mapping, sizeof(header));
+		if (!header.valid(sizeof(T)) ||
+			header.count > (mapping_size - Tree_Snapshot_Header::keys_offset) / sizeof(T)) {
+			close();
+			return false;
+		}
+		keys = reinterpret_cast<const T*>(mapping + Tree_Snapshot_Header::keys_offset);
+		keys_count = static_cast<size_t>(header.count);
+		return true;
+	}
+
+	bool is_open() const noexcept { return mapping != nullptr; }
+
+	void close()
+	{
+#ifdef _WIN32
+		if (mapping) UnmapViewOfFile(mapping);
+		if (mapping_handle) CloseHandle(mapping_handle);
+		if (file_handle != INVALID_HANDLE_VALUE) CloseHandle(file_handle);
+		mapping_handle = nullptr;
+		file_handle = INVALID_HANDLE_VALUE;
+#else
+		if (mapping) munmap(const_cast<char*>(mapping), mapping_size);
+#endif
+		mapping = nullptr;
+		mapping_size = 0;
+		keys = nullptr;
+		keys_count = 0;
+	}
+
+	const_iterator begin() const noexcept { return keys; }
+	const_iterator end() const noexcept { return keys + keys_count; }
+	const_reverse_iterator rbegin() const noexcept { return const_reverse_iterator(end()); }
+	const_reverse_iterator rend() const noexcept { return const_reverse_iterator(begin()); }
+
+	size_type size() const noexcept { return keys_count; }
+	bool empty() const noexcept { return keys_count == 0; }
+	key_compare key_comp() const noexcept { return cmp; }
+	value_compare value_comp() const noexcept { return cmp; }
+
+	const_iterator lower_bound(const value_type& key) const {
+		return std::lower_bound(begin(), end(), key, cmp);
+	}
+
+	const_iterator upper_bound(const value_type& key) const {
+		return std::upper_bound(begin(), end(), key, cmp);
+	}
+
+	const_iterator find(const value_type& key) const {
+		const_iterator it = lower_bound(key);
+		return it != end() && !cmp(key, *it) ? it : end();
+	}
+
+	size_type count(const value_type& key) const {
+		return find(key) != end() ? 1 : 0;
+	}
+
+	std::pair<const_iterator, const_iterator> equal_range(const value_type& key) const {
+		const_iterator it = lower_bound(key);
+		if (it != end() && !cmp(key, *it))
+			return std::make_pair(it, it + 1);
+		return std::make_pair(it, it);
+	}
+
+private:
+	bool map_file(const std::string& path)
+	{
+#ifdef _WIN32
+		file_handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file_handle == INVALID_HANDLE_VALUE) return false;
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(file_handle, &file_size) || file_size.QuadPart == 0) {
+			close();
+			return false;
+		}
+		mapping_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mapping_handle) {
+			close();
+			return false;
+		}
+		mapping = static_cast<const char*>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+		if (!mapping) {
+			close();
+			return false;
+		}
+		mapping_size = static_cast<size_t>(file_size.QuadPart);
+		return true;
+#else
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) return false;
+		struct stat info;
+		if (fstat(fd, &info) != 0 || info.st_size == 0) {
+			::close(fd);
+			return false;
+		}
+		void* addr = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+		//  Отображение остаётся действительным и после закрытия дескриптора
+		::close(fd);
+		if (addr == MAP_FAILED) return false;
+		mapping = static_cast<const char*>(addr);
+		mapping_size = static_cast<size_t>(info.st_size);
+		return true;
+#endif
+	}
+};
+
+template <class Key, class Compare>
+bool operator==(const Mapped_Search_Tree<Key, Compare>& x, const Mapped_Search_Tree<Key, Compare>& y) {
+	return std::equal(x.begin(), x.end(), y.begin(), y.end());
+}
+
+template <class Key, class Compare>
+bool operator!=(const Mapped_Search_Tree<Key, Compare>& x, const Mapped_Search_Tree<Key, Compare>& y) {
+	return !(x == y);
+}
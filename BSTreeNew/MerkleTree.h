@@ -0,0 +1,374 @@
+﻿#pragma once
+
+//  Дерево с хэшами поддеревьев для быстрого сравнения реплик одного множества ключей.
+//    Политика дополнения Merkle_Subtree_Hash хранит в каждом узле число ключей поддерева и сумму (по модулю 2^64)
+//    перемешанных хэшей его ключей. Сумма не зависит от формы дерева, поэтому у реплик с одинаковыми ключами,
+//    но разной историей вставок, совпадают хэши любых диапазонов ключей [lo, hi). Хэш и число ключей диапазона
+//    считаются двумя спусками от корня, O(h).
+//  diff сравнивает два дерева диапазонами: совпавший диапазон пропускается целиком, несовпавший делится
+//    пополам по рангу ключей, маленькие диапазоны сравниваются поштучно. Для d различий это O(d*log(n))
+//    диапазонов, каждый – за O(h). Совпадение хэшей разных множеств возможно с вероятностью около 2^-64.
+//  Для сверки реплик в разных процессах – Merkle_Digest, список диапазонов с хэшами, который записывается в поток
+//    (канал, сокет) и читается на другой стороне. Обмен:
+//      A: d = a.digest();                    отправить d
+//      B: d = b.reconcile(d, diff_b);        отправить d
+//      A: d = a.reconcile(d, diff_a);        отправить d  ... пока полученный список не пуст
+//    Каждая сторона отвечает только на несовпавшие диапазоны: делит их по своим ключам на части или, если
+//    ключей мало, передаёт их явно. По окончании diff_a и diff_b содержат различия с точки зрения каждой стороны.
+
+#include "BStree.h"
+#include <vector>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <iterator>
+#include <algorithm>
+#include <functional>
+
+//  Хэш и число ключей множества (поддерева, диапазона)
+struct Merkle_Summary
+{
+	std::uint64_t hash = 0;
+	std::uint64_t count = 0;
+
+	Merkle_Summary& operator+=(const Merkle_Summary& other) noexcept
+	{
+		hash += other.hash;
+		count += other.count;
+		return *this;
+	}
+
+	friend Merkle_Summary operator-(Merkle_Summary a, const Merkle_Summary& b) noexcept
+	{
+		a.hash -= b.hash;
+		a.count -= b.count;
+		return a;
+	}
+
+	friend bool operator==(const Merkle_Summary& a, const Merkle_Summary& b) noexcept { return a.hash == b.hash && a.count == b.count; }
+	friend bool operator!=(const Merkle_Summary& a, const Merkle_Summary& b) noexcept { return !(a == b); }
+};
+
+//  Политика дополнения (см. No_Tree_Augment): хэш и размер поддерева. Хэш ключа перемешивается (финализатор
+//    splitmix64), т.к. std::hash для целых – тождественная функция, а сумма близких чисел легко совпадает
+template<typename T, class Hash = std::hash<T>>
+struct Merkle_Subtree_Hash
+{
+	static constexpr bool enabled = true;
+	using value_type = Merkle_Summary;
+
+	static std::uint64_t key_hash(const T& key)
+	{
+		std::uint64_t x = static_cast<std::uint64_t>(Hash()(key)) + 0x9E3779B97F4A7C15ull;
+		x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+		x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+		return x ^ (x >> 31);
+	}
+
+	template<class Compare>
+	static void update(const Compare&, Merkle_Summary& value, const T& key, const Merkle_Summary* left, const Merkle_Summary* right)
+	{
+		value.hash = key_hash(key);
+		value.count = 1;
+		if (left) value += *left;
+		if (right) value += *right;
+	}
+};
+
+//  Различия двух множеств: ключи, которые есть только в этом дереве, и ключи, которые есть только в другом
+template<typename T>
+struct Tree_Diff
+{
+	std::vector<T> only_here;
+	std::vector<T> only_there;
+
+	bool empty() const noexcept { return only_here.empty() && only_there.empty(); }
+};
+
+//  Диапазон ключей [lo, hi) с хэшем; отсутствующая граница – бесконечность. Если передаются сами ключи
+//    диапазона (explicit_keys), они лежат в keys по возрастанию. answer – ответ на явные ключи, на него не отвечают
+template<typename T>
+struct Merkle_Range
+{
+	static constexpr std::uint32_t has_lo = 1;
+	static constexpr std::uint32_t has_hi = 2;
+	static constexpr std::uint32_t explicit_keys = 4;
+	static constexpr std::uint32_t answer = 8;
+
+	std::uint32_t flags = 0;
+	T lo{};
+	T hi{};
+	Merkle_Summary summary;
+	std::vector<T> keys;
+
+	const T* lower() const noexcept { return flags & has_lo ? &lo : nullptr; }
+	const T* upper() const noexcept { return flags & has_hi ? &hi : nullptr; }
+};
+
+//  Список диапазонов для передачи между процессами. Двоичный формат (порядок байтов платформы, ключи –
+//    побайтовые копии T, поэтому только для тривиально копируемых ключей и одинаковых платформ):
+//    заголовок: "BSTM", версия (u32), размер ключа (u32), число диапазонов (u64);
+//    диапазон: флаги (u32), count (u64), hash (u64), [lo], [hi], [число ключей (u64), ключи]
+template<typename T>
+struct Merkle_Digest
+{
+	static constexpr char signature[4] = { 'B', 'S', 'T', 'M' };
+	static constexpr std::uint32_t current_version = 1;
+
+	std::vector<Merkle_Range<T>> ranges;
+
+	bool empty() const noexcept { return ranges.empty(); }
+
+	//  Запись в поток; false при ошибке записи
+	bool write(std::ostream& out) const
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "digests require trivially copyable keys");
+		out.write(signature, sizeof(signature));
+		put(out, current_version);
+		put(out, static_cast<std::uint32_t>(sizeof(T)));
+		put(out, static_cast<std::uint64_t>(ranges.size()));
+		for (const Merkle_Range<T>& range : ranges) {
+			put(out, range.flags);
+			put(out, range.summary.count);
+			put(out, range.summary.hash);
+			if (range.flags & Merkle_Range<T>::has_lo) put(out, range.lo);
+			if (range.flags & Merkle_Range<T>::has_hi) put(out, range.hi);
+			if (range.flags & Merkle_Range<T>::explicit_keys) {
+				put(out, static_cast<std::uint64_t>(range.keys.size()));
+				if (!range.keys.empty())
+					out.write(reinterpret_cast<const char*>(range.keys.data()), range.keys.size() * sizeof(T));
+			}
+		}
+		out.flush();
+		return static_cast<bool>(out);
+	}
+
+	//  Чтение из потока; false, если данные повреждены или записаны для ключей другого размера
+	bool read(std::istream& in)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "digests require trivially copyable keys");
+		ranges.clear();
+		char magic[4];
+		std::uint32_t version = 0, key_size = 0;
+		std::uint64_t count = 0;
+		if (!in.read(magic, sizeof(magic)) || !get(in, version) || !get(in, key_size) || !get(in, count))
+			return false;
+		if (!std::equal(magic, magic + 4, signature) || version != current_version || key_size != sizeof(T))
+			return false;
+		for (std::uint64_t i = 0; i < count; ++i) {
+			Merkle_Range<T> range;
+			if (!get(in, range.flags) || !get(in, range.summary.count) || !get(in, range.summary.hash))
+				return false;
+			if ((range.flags & Merkle_Range<T>::has_lo) && !get(in, range.lo)) return false;
+			if ((range.flags & Merkle_Range<T>::has_hi) && !get(in, range.hi)) return false;
+			if (range.flags & Merkle_Range<T>::explicit_keys) {
+				std::uint64_t keys = 0;
+				if (!get(in, keys) || keys != range.summary.count) return false;
+				//  Поштучно: повреждённое число ключей не должно приводить к огромному выделению памяти
+				for (T key; keys != 0; --keys) {
+					if (!get(in, key)) return false;
+					range.keys.push_back(key);
+				}
+			}
+			ranges.push_back(std::move(range));
+		}
+		return true;
+	}
+
+private:
+	template<typename V>
+	static void put(std::ostream& out, const V& value) { out.write(reinterpret_cast<const char*>(&value), sizeof(V)); }
+
+	template<typename V>
+	static bool get(std::istream& in, V& value) { return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(V))); }
+};
+
+template<typename T, class Compare = std::less<T>, class Allocator = std::allocator<T>, class Stats = No_Tree_Stats,
+	class Hash = std::hash<T>>
+class Merkle_Search_Tree
+	: public Binary_Search_Tree<T, Compare, Allocator, Stats, Merkle_Subtree_Hash<T, Hash>>
+{
+	using tree_type = Binary_Search_Tree<T, Compare, Allocator, Stats, Merkle_Subtree_Hash<T, Hash>>;
+	using Node = typename tree_type::Node;
+
+	//  Диапазоны не больше этого размера diff сравнивает поштучно
+	static constexpr std::uint64_t diff_leaf_size = 16;
+
+public:
+	using digest_type = Merkle_Digest<T>;
+	using range_type = Merkle_Range<T>;
+	using diff_type = Tree_Diff<T>;
+
+	using tree_type::tree_type;
+
+	//  Хэш и число ключей всего дерева
+	Merkle_Summary summary() const
+	{
+		const Node* root = this->dummy->parent;
+		return root != this->dummy ? root->augment : Merkle_Summary();
+	}
+
+	//  Хэш и число ключей из [lo, hi); nullptr – граница отсутствует
+	Merkle_Summary range_summary(const T* lo, const T* hi) const
+	{
+		Merkle_Summary result = hi ? summary_below(*hi) : summary();
+		return lo ? result - summary_below(*lo) : result;
+	}
+
+	Merkle_Summary range_summary(const T& lo, const T& hi) const { return range_summary(&lo, &hi); }
+
+	//  Различия с другим деревом; ключи в обоих списках – по возрастанию
+	diff_type diff(const Merkle_Search_Tree& other) const
+	{
+		diff_type result;
+		diff_range(other, nullptr, nullptr, result);
+		return result;
+	}
+
+	//  Начальный список для сверки с другим процессом: всё множество одним диапазоном, разделённым на части
+	digest_type digest(size_t parts = 16) const
+	{
+		digest_type result;
+		describe(range_type(), parts, result);
+		return result;
+	}
+
+	//  Ответ на список, полученный от другой стороны. Различия, выясненные по явно переданным ключам,
+	//    добавляются в diff. Пустой ответ означает, что отвечать больше не на что
+	digest_type reconcile(const digest_type& remote, diff_type& diff, size_t parts = 16) const
+	{
+		digest_type reply;
+		for (const range_type& range : remote.ranges) {
+			Merkle_Summary local = range_summary(range.lower(), range.upper());
+			if (local == range.summary) continue;
+			if (range.flags & range_type::explicit_keys) {
+				std::vector<T> keys = keys_in(range.lower(), range.upper());
+				compare_keys(keys, range.keys, diff);
+				//  Другой стороне тоже нужны наши ключи, чтобы узнать различия
+				if (!(range.flags & range_type::answer)) {
+					range_type answer = bounds_of(range);
+					answer.flags |= range_type::explicit_keys | range_type::answer;
+					answer.summary = local;
+					answer.keys = std::move(keys);
+					reply.ranges.push_back(std::move(answer));
+				}
+			}
+			else
+				describe(bounds_of(range), parts, reply);
+		}
+		return reply;
+	}
+
+private:
+	//  Хэш и число ключей, меньших bound: при спуске вправо всё левое поддерево и сам узел попадают в сумму
+	Merkle_Summary summary_below(const T& bound) const
+	{
+		const Compare& cmp = this->comparator();
+		const Node* nil = this->dummy;
+		this->stats().lookup();
+		Merkle_Summary result;
+		for (const Node* node = nil->parent; node != nil;) {
+			if (cmp(node->data, bound)) {
+				if (node->left != nil) result += node->left->augment;
+				result.hash += Merkle_Subtree_Hash<T, Hash>::key_hash(node->data);
+				++result.count;
+				node = node->right;
+			}
+			else
+				node = node->left;
+		}
+		return result;
+	}
+
+	//  Ключ с номером rank (с нуля) по возрастанию; rank < size()
+	const T& select(std::uint64_t rank) const
+	{
+		const Node* nil = this->dummy;
+		const Node* node = nil->parent;
+		for (;;) {
+			std::uint64_t left = node->left != nil ? node->left->augment.count : 0;
+			if (rank < left)
+				node = node->left;
+			else if (rank == left)
+				return node->data;
+			else {
+				rank -= left + 1;
+				node = node->right;
+			}
+		}
+	}
+
+	std::vector<T> keys_in(const T* lo, const T* hi) const
+	{
+		const Compare& cmp = this->comparator();
+		std::vector<T> keys;
+		for (auto it = lo ? this->lower_bound(*lo) : this->begin(); it != this->end() && (!hi || cmp(*it, *hi)); ++it)
+			keys.push_back(*it);
+		return keys;
+	}
+
+	void compare_keys(const std::vector<T>& here, const std::vector<T>& there, diff_type& diff) const
+	{
+		const Compare& cmp = this->comparator();
+		std::set_difference(here.begin(), here.end(), there.begin(), there.end(), std::back_inserter(diff.only_here), cmp);
+		std::set_difference(there.begin(), there.end(), here.begin(), here.end(), std::back_inserter(diff.only_there), cmp);
+	}
+
+	void diff_range(const Merkle_Search_Tree& other, const T* lo, const T* hi, diff_type& diff) const
+	{
+		Merkle_Summary here = range_summary(lo, hi);
+		Merkle_Summary there = other.range_summary(lo, hi);
+		if (here == there) return;
+		if (here.count + there.count <= diff_leaf_size) {
+			compare_keys(keys_in(lo, hi), other.keys_in(lo, hi), diff);
+			return;
+		}
+		//  Делим по среднему ключу той стороны, где ключей больше: обе половины у неё непусты
+		const Merkle_Search_Tree& larger = here.count >= there.count ? *this : other;
+		std::uint64_t count = std::max(here.count, there.count);
+		std::uint64_t first = lo ? larger.summary_below(*lo).count : 0;
+		const T& middle = larger.select(first + count / 2);
+		diff_range(other, lo, &middle, diff);
+		diff_range(other, &middle, hi, diff);
+	}
+
+	static range_type bounds_of(const range_type& range)
+	{
+		range_type result;
+		result.flags = range.flags & (range_type::has_lo | range_type::has_hi);
+		result.lo = range.lo;
+		result.hi = range.hi;
+		return result;
+	}
+
+	//  Описание своих ключей диапазона: явно, если их не больше parts, иначе – parts частей равного размера
+	void describe(const range_type& bounds, size_t parts, digest_type& out) const
+	{
+		if (parts < 2) parts = 2;
+		Merkle_Summary local = range_summary(bounds.lower(), bounds.upper());
+		if (local.count <= parts) {
+			range_type range = bounds;
+			range.flags |= range_type::explicit_keys;
+			range.summary = local;
+			range.keys = keys_in(bounds.lower(), bounds.upper());
+			out.ranges.push_back(std::move(range));
+			return;
+		}
+		std::uint64_t first = bounds.lower() ? summary_below(*bounds.lower()).count : 0;
+		range_type part = bounds;
+		for (size_t i = 1; i <= parts; ++i) {
+			if (i < parts) {
+				part.hi = select(first + local.count * i / parts);
+				part.flags |= range_type::has_hi;
+			}
+			else {
+				part.hi = bounds.hi;
+				part.flags = (part.flags & ~range_type::has_hi) | (bounds.flags & range_type::has_hi);
+			}
+			part.summary = range_summary(part.lower(), part.upper());
+			out.ranges.push_back(part);
+			part.lo = part.hi;
+			part.flags |= range_type::has_lo;
+		}
+	}
+};
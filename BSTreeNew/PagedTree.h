@@ -0,0 +1,650 @@
+﻿#pragma once
+
+//  Внешнее (дисковое) дерево поиска для множеств, не помещающихся в память, – B+-дерево в файле.
+//  Интерфейс поиска и итераторов повторяет Binary_Search_Tree: insert, find, lower_bound, upper_bound,
+//    equal_range, count, erase, begin/end. Ключи должны быть тривиально копируемыми – они хранятся в страницах
+//    файла побайтно.
+
+//  Устройство:
+//    – файл состоит из страниц фиксированного размера PageSize; страница 0 – служебная (корень, высота, размер),
+//      остальные – узлы дерева: внутренние (ключи-разделители и номера дочерних страниц) и листья (ключи);
+//    – листья связаны в двусвязный список, по которому идут итераторы;
+//    – страницы читаются через буферный пул с вытеснением давно не использованных (LRU) и ограничением памяти;
+//    – при переходе итератора на очередной лист операционной системе сообщается, что скоро понадобится
+//      следующий лист (упреждающее чтение), так что последовательный просмотр не ждёт диска на каждом листе.
+//  Удаление «ленивое»: ключ убирается из листа, но листья не сливаются – пустые листья пропускаются итераторами.
+//    Для сценариев «много вставок, мало удалений» это проще и не ухудшает поиск.
+
+//  Итератор хранит копию текущего ключа и при разыменовании возвращает её по значению, т.к. страница может быть
+//    вытеснена из пула в любой момент.
+//    Любое изменение дерева делает итераторы недействительными.
+
+#include "BStree.h"
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <optional>
+
+#ifndef _WIN32
+	#include <fcntl.h>
+#endif
+
+template<typename T, class Compare = std::less<T>, size_t PageSize = 4096>
+class Paged_Search_Tree
+{
+	static_assert(std::is_trivially_copyable<T>::value, "paged trees require trivially copyable keys");
+	static_assert(alignof(T) <= 16, "keys must not require alignment stricter than 16 bytes");
+
+	Compare cmp = Compare();
+
+	using page_id = std::uint32_t;
+	//  Номер 0 занят служебной страницей, поэтому как ссылка на узел означает «нет страницы»
+	static constexpr page_id no_page = 0;
+
+	//  Служебная страница
+	struct Meta
+	{
+		char magic[4];
+		std::uint32_t version;
+		std::uint32_t page_size;
+		std::uint32_t key_size;
+		page_id root;
+		page_id first_leaf;
+		page_id last_leaf;
+		page_id page_count;
+		std::uint32_t height;
+		std::uint32_t reserved;
+		std::uint64_t count;
+	};
+
+	//  Заголовок страницы-узла. Ключи начинаются сразу за ним (16 байт – подходит для любого выравнивания T)
+	struct Page_Header
+	{
+		std::uint16_t leaf;
+		std::uint16_t count;
+		std::uint32_t reserved;
+		page_id prev;   //  соседние листья (для внутренних узлов не используются)
+		page_id next;
+	};
+	static_assert(sizeof(Page_Header) == 16, "unexpected page header layout");
+
+	static constexpr size_t leaf_capacity = (PageSize - sizeof(Page_Header)) / sizeof(T);
+	static constexpr size_t internal_capacity = (PageSize - sizeof(Page_Header) - sizeof(page_id)) / (sizeof(T) + sizeof(page_id));
+	static constexpr size_t children_offset = (sizeof(Page_Header) + internal_capacity * sizeof(T) + alignof(page_id) - 1) / alignof(page_id) * alignof(page_id);
+	static_assert(leaf_capacity >= 3 && internal_capacity >= 3, "page size too small for this key type");
+	//  Число ключей страницы хранится в Page_Header::count (16 бит)
+	static_assert(leaf_capacity <= UINT16_MAX && internal_capacity <= UINT16_MAX, "page size too large for this key type");
+
+	static Page_Header* header(char* page) noexcept { return reinterpret_cast<Page_Header*>(page); }
+	static T* keys(char* page) noexcept { return reinterpret_cast<T*>(page + sizeof(Page_Header)); }
+	static page_id* children(char* page) noexcept { return reinterpret_cast<page_id*>(page + children_offset); }
+
+	//  ==========================================================================================
+	//  Буферный пул
+
+	struct Frame
+	{
+		page_id id = no_page;
+		bool dirty = false;
+		unsigned pins = 0;
+		std::list<size_t>::iterator lru_position;
+	};
+
+	std::FILE* file = nullptr;
+	Meta meta{};
+	std::vector<char> pool_memory;
+	std::vector<Frame> frames;
+	size_t frames_used = 0;
+	//  Номер страницы -> номер кадра
+	std::unordered_map<page_id, size_t> page_table;
+	//  Кадры в порядке использования: в начале – недавно использованные
+	std::list<size_t> lru;
+
+	size_t hits = 0, misses = 0, reads = 0, writes = 0;
+
+	char* frame_data(size_t frame) noexcept { return pool_memory.data() + frame * PageSize; }
+
+	static bool seek(std::FILE* f, std::uint64_t offset)
+	{
+#ifdef _WIN32
+		return _fseeki64(f, static_cast<long long>(offset), SEEK_SET) == 0;
+#else
+		return fseeko(f, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+	}
+
+	bool write_page(page_id id, const char* data)
+	{
+		++writes;
+		return seek(file, static_cast<std::uint64_t>(id) * PageSize) && std::fwrite(data, 1, PageSize, file) == PageSize;
+	}
+
+	//  Свободный кадр: ещё не использованный или самый давний незакреплённый (с записью, если он изменён).
+	//    Если изменённую страницу записать не удалось, она остаётся в пуле, а вызывающему бросается исключение
+	size_t victim_frame()
+	{
+		if (frames_used < frames.size()) {
+			lru.push_front(frames_used);
+			frames[frames_used].lru_position = lru.begin();
+			return frames_used++;
+		}
+		for (auto it = lru.rbegin(); it != lru.rend(); ++it) {
+			Frame& frame = frames[*it];
+			if (frame.pins != 0) continue;
+			if (frame.dirty && !write_page(frame.id, frame_data(*it)))
+				throw std::runtime_error("paged tree: cannot write back an evicted page");
+			if (frame.id != no_page)
+				page_table.erase(frame.id);
+			frame.dirty = false;
+			size_t index = *it;
+			lru.splice(lru.begin(), lru, frame.lru_position);
+			return index;
+		}
+		//  Все кадры закреплены – пул слишком мал для высоты дерева. Отдать закреплённый кадр нельзя: его страница используется
+		throw std::length_error("paged tree: buffer pool is exhausted");
+	}
+
+	//  Закрепление страницы в пуле. fresh – страница только что выделена, читать её из файла не нужно.
+	//    Если страницу прочитать не удалось, бросается исключение, а кадр остаётся свободным: обнулённая страница
+	//    выглядела бы как узел со ссылками на служебную страницу и при записи затёрла бы настоящие данные
+	size_t pin(page_id id, bool fresh = false)
+	{
+		auto found = page_table.find(id);
+		if (found != page_table.end()) {
+			++hits;
+			Frame& frame = frames[found->second];
+			++frame.pins;
+			lru.splice(lru.begin(), lru, frame.lru_position);
+			return found->second;
+		}
+		++misses;
+		size_t index = victim_frame();
+		Frame& frame = frames[index];
+		if (fresh)
+			std::memset(frame_data(index), 0, PageSize);
+		else {
+			++reads;
+			if (!seek(file, static_cast<std::uint64_t>(id) * PageSize) || std::fread(frame_data(index), 1, PageSize, file) != PageSize) {
+				frame.id = no_page;
+				throw std::runtime_error("paged tree: cannot read a page");
+			}
+		}
+		page_table[id] = index;
+		frame.id = id;
+		frame.pins = 1;
+		return index;
+	}
+
+	//  Закреплённая страница; открепляется деструктором
+	class Page_Guard
+	{
+		Paged_Search_Tree* tree;
+		size_t frame;
+	public:
+		Page_Guard(Paged_Search_Tree* owner, page_id id, bool fresh = false) : tree(owner), frame(owner->pin(id, fresh)) {}
+		Page_Guard(const Page_Guard&) = delete;
+		Page_Guard& operator=(const Page_Guard&) = delete;
+		~Page_Guard() { --tree->frames[frame].pins; }
+
+		char* data() const noexcept { return tree->frame_data(frame); }
+		void mark_dirty() noexcept { tree->frames[frame].dirty = true; }
+	};
+
+	page_id allocate_page()
+	{
+		return meta.page_count++;
+	}
+
+	//  Подсказка ОС: страница скоро понадобится (чтение в фоне, без ожидания)
+	void prefetch(page_id id)
+	{
+		if (id == no_page || page_table.count(id)) return;
+#if !defined(_WIN32) && defined(POSIX_FADV_WILLNEED)
+		posix_fadvise(fileno(file), static_cast<off_t>(id) * PageSize, PageSize, POSIX_FADV_WILLNEED);
+#endif
+	}
+
+	//  ==========================================================================================
+	//  Поиск
+
+	//  Позиция первого ключа в странице, не меньшего key
+	size_t lower_index(char* page, const T& key) const
+	{
+		const T* first = keys(page);
+		return std::lower_bound(first, first + header(page)->count, key, cmp) - first;
+	}
+
+	//  Номер дочерней страницы, в которой нужно искать key: разделитель i – минимальный ключ поддерева i+1
+	size_t child_index(char* page, const T& key) const
+	{
+		const T* first = keys(page);
+		return std::upper_bound(first, first + header(page)->count, key, cmp) - first;
+	}
+
+	page_id find_leaf(const T& key)
+	{
+		page_id current = meta.root;
+		for (std::uint32_t level = 1; level < meta.height; ++level) {
+			Page_Guard page(this, current);
+			current = children(page.data())[child_index(page.data(), key)];
+		}
+		return current;
+	}
+
+public:
+	class iterator
+	{
+		friend class Paged_Search_Tree;
+		Paged_Search_Tree* tree = nullptr;
+		page_id leaf = no_page;
+		size_t index = 0;
+		T value{};
+
+		iterator(Paged_Search_Tree* owner, page_id leaf_page, size_t position) : tree(owner), leaf(leaf_page), index(position)
+		{
+			settle_forward();
+		}
+
+		//  Переход на первый существующий ключ начиная с (leaf, index), пропуская пустые листья
+		void settle_forward()
+		{
+			while (leaf != no_page) {
+				Page_Guard page(tree, leaf);
+				Page_Header* head = header(page.data());
+				//  Вошли в лист с начала – заранее просим следующий за ним
+				if (index == 0)
+					tree->prefetch(head->next);
+				if (index < head->count) {
+					std::memcpy(&value, keys(page.data()) + index, sizeof(T));
+					return;
+				}
+				leaf = head->next;
+				index = 0;
+			}
+		}
+
+	public:
+		using iterator_category = std::bidirectional_iterator_tag;
+		using value_type = T;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const T*;
+		//  Ссылка на ключ в странице не может быть постоянной, поэтому разыменование возвращает копию
+		using reference = T;
+
+		iterator() = default;
+
+		T operator*() const { return value; }
+		const T* operator->() const { return &value; }
+
+		iterator& operator++()
+		{
+			++index;
+			settle_forward();
+			return *this;
+		}
+
+		iterator operator++(int)
+		{
+			iterator it(*this);
+			++*this;
+			return it;
+		}
+
+		iterator& operator--()
+		{
+			page_id current = leaf;
+			size_t position = index;
+			if (current == no_page) {
+				//  Из end() – на последний лист
+				current = tree->meta.last_leaf;
+				Page_Guard page(tree, current);
+				position = header(page.data())->count;
+			}
+			while (current != no_page) {
+				Page_Guard page(tree, current);
+				if (position > 0) {
+					leaf = current;
+					index = position - 1;
+					std::memcpy(&value, keys(page.data()) + index, sizeof(T));
+					return *this;
+				}
+				current = header(page.data())->prev;
+				if (current != no_page) {
+					Page_Guard prev(tree, current);
+					position = header(prev.data())->count;
+				}
+			}
+			return *this;
+		}
+
+		iterator operator--(int)
+		{
+			iterator it(*this);
+			--*this;
+			return it;
+		}
+
+		friend bool operator==(const iterator& a, const iterator& b) { return a.leaf == b.leaf && a.index == b.index; }
+		friend bool operator!=(const iterator& a, const iterator& b) { return !(a == b); }
+	};
+
+	using key_type = T;
+	using value_type = T;
+	using key_compare = Compare;
+	using value_compare = Compare;
+	using size_type = size_t;
+	using difference_type = std::ptrdiff_t;
+	using const_iterator = iterator;
+	using reverse_iterator = std::reverse_iterator<iterator>;
+	using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+	//  Статистика буферного пула – для оценки того, насколько рабочее множество помещается в память
+	struct Pool_Stats
+	{
+		size_t hits, misses, reads, writes, frames;
+	};
+
+	//  memory_budget – объём памяти под буферный пул в байтах (не меньше 16 страниц)
+	explicit Paged_Search_Tree(size_t memory_budget = 64u << 20, Compare comparator = Compare()) : cmp(comparator)
+	{
+		size_t count = std::max<size_t>(memory_budget / PageSize, 16);
+		pool_memory.resize(count * PageSize);
+		frames.resize(count);
+	}
+
+	Paged_Search_Tree(const Paged_Search_Tree&) = delete;
+	Paged_Search_Tree& operator=(const Paged_Search_Tree&) = delete;
+
+	~Paged_Search_Tree()
+	{
+		close();
+	}
+
+	//  Открытие файла дерева. truncate – начать с пустого дерева. Возвращает false при ошибке или неверном формате
+	bool open(const std::string& path, bool truncate = false)
+	{
+		close();
+		if (!truncate)
+			file = std::fopen(path.c_str(), "r+b");
+		if (!file) {
+			file = std::fopen(path.c_str(), "w+b");
+			if (!file) return false;
+			std::memcpy(meta.magic, "BSTP", 4);
+			meta.version = 1;
+			meta.page_size = PageSize;
+			meta.key_size = sizeof(T);
+			meta.page_count = 1;
+			meta.root = meta.first_leaf = meta.last_leaf = allocate_page();
+			meta.height = 1;
+			meta.count = 0;
+			Page_Guard root(this, meta.root, true);
+			header(root.data())->leaf = 1;
+			root.mark_dirty();
+			return true;
+		}
+		if (std::fread(&meta, sizeof(meta), 1, file) != 1 || std::memcmp(meta.magic, "BSTP", 4) != 0 ||
+			meta.version != 1 || meta.page_size != PageSize || meta.key_size != sizeof(T)) {
+			std::fclose(file);
+			file = nullptr;
+			return false;
+		}
+		return true;
+	}
+
+	bool is_open() const noexcept { return file != nullptr; }
+
+	//  Запись изменённых страниц и служебной страницы в файл. Возвращает false, если какую-то страницу
+	//    записать не удалось; такие страницы остаются изменёнными и будут записаны при следующем flush
+	bool flush()
+	{
+		if (!file) return true;
+		bool written = true;
+		for (size_t i = 0; i < frames_used; ++i)
+			if (frames[i].dirty) {
+				if (write_page(frames[i].id, frame_data(i)))
+					frames[i].dirty = false;
+				else
+					written = false;
+			}
+		std::vector<char> meta_page(PageSize, 0);
+		std::memcpy(meta_page.data(), &meta, sizeof(meta));
+		written = write_page(0, meta_page.data()) && written;
+		return std::fflush(file) == 0 && written;
+	}
+
+	//  Возвращает false, если при записи изменений или закрытии файла произошла ошибка
+	bool close()
+	{
+		if (!file) return true;
+		bool written = flush();
+		written = std::fclose(file) == 0 && written;
+		file = nullptr;
+		page_table.clear();
+		lru.clear();
+		frames.assign(frames.size(), Frame());
+		frames_used = 0;
+		return written;
+	}
+
+	size_type size() const noexcept { return static_cast<size_type>(meta.count); }
+	bool empty() const noexcept { return meta.count == 0; }
+	key_compare key_comp() const noexcept { return cmp; }
+	value_compare value_comp() const noexcept { return cmp; }
+	Pool_Stats pool_stats() const noexcept { return Pool_Stats{ hits, misses, reads, writes, frames.size() }; }
+
+	iterator begin() { return iterator(this, meta.first_leaf, 0); }
+	iterator end() { return iterator(this, no_page, 0); }
+	reverse_iterator rbegin() { return reverse_iterator(end()); }
+	reverse_iterator rend() { return reverse_iterator(begin()); }
+
+	iterator lower_bound(const T& key)
+	{
+		page_id leaf = find_leaf(key);
+		size_t position;
+		{
+			Page_Guard page(this, leaf);
+			position = lower_index(page.data(), key);
+		}
+		return iterator(this, leaf, position);
+	}
+
+	iterator upper_bound(const T& key)
+	{
+		page_id leaf = find_leaf(key);
+		size_t position;
+		{
+			Page_Guard page(this, leaf);
+			const T* first = keys(page.data());
+			position = std::upper_bound(first, first + header(page.data())->count, key, cmp) - first;
+		}
+		return iterator(this, leaf, position);
+	}
+
+	iterator find(const T& key)
+	{
+		iterator it = lower_bound(key);
+		return it != end() && !cmp(key, *it) ? it : end();
+	}
+
+	size_type count(const T& key) { return find(key) != end() ? 1 : 0; }
+
+	std::pair<iterator, iterator> equal_range(const T& key)
+	{
+		iterator it = lower_bound(key);
+		if (it == end() || cmp(key, *it))
+			return std::make_pair(it, it);
+		iterator next = it;
+		return std::make_pair(it, ++next);
+	}
+
+	std::pair<iterator, bool> insert(const T& key)
+	{
+		//  Путь от корня к листу: страница и номер дочерней, в которую спустились
+		std::vector<std::pair<page_id, size_t>> path;
+		page_id current = meta.root;
+		for (std::uint32_t level = 1; level < meta.height; ++level) {
+			Page_Guard page(this, current);
+			size_t child = child_index(page.data(), key);
+			path.emplace_back(current, child);
+			current = children(page.data())[child];
+		}
+
+		page_id leaf = current;
+		T separator;
+		page_id right_page;
+		{
+			Page_Guard page(this, leaf);
+			Page_Header* head = header(page.data());
+			size_t position = lower_index(page.data(), key);
+			if (position < head->count && !cmp(key, keys(page.data())[position]))
+				return std::make_pair(iterator(this, leaf, position), false);
+
+			//  Размер увеличивается, только когда ключ уже лежит в листе: деление может бросить исключение
+			page.mark_dirty();
+			if (head->count < leaf_capacity) {
+				T* first = keys(page.data());
+				std::memmove(first + position + 1, first + position, (head->count - position) * sizeof(T));
+				std::memcpy(first + position, &key, sizeof(T));
+				++head->count;
+				++meta.count;
+				return std::make_pair(iterator(this, leaf, position), true);
+			}
+
+			//  Лист переполнен – делим пополам, правая половина уходит в новую страницу
+			right_page = allocate_page();
+			Page_Guard right(this, right_page, true);
+			right.mark_dirty();
+			split_leaf(page.data(), right.data(), leaf, right_page, position, key);
+			++meta.count;
+			std::memcpy(&separator, keys(right.data()), sizeof(T));
+		}
+
+		//  Разделитель поднимается вверх, пока очередной внутренний узел не примет его без деления
+		for (auto level = path.rbegin(); level != path.rend(); ++level) {
+			Page_Guard page(this, level->first);
+			page.mark_dirty();
+			if (header(page.data())->count < internal_capacity) {
+				insert_separator(page.data(), level->second, separator, right_page);
+				return std::make_pair(find(key), true);
+			}
+			page_id new_page = allocate_page();
+			Page_Guard right(this, new_page, true);
+			right.mark_dirty();
+			separator = split_internal(page.data(), right.data(), level->second, separator, right_page);
+			right_page = new_page;
+		}
+
+		//  Поделился корень – дерево растёт вверх
+		page_id new_root = allocate_page();
+		Page_Guard root(this, new_root, true);
+		root.mark_dirty();
+		header(root.data())->leaf = 0;
+		header(root.data())->count = 1;
+		std::memcpy(keys(root.data()), &separator, sizeof(T));
+		children(root.data())[0] = meta.root;
+		children(root.data())[1] = right_page;
+		meta.root = new_root;
+		++meta.height;
+		return std::make_pair(find(key), true);
+	}
+
+	size_type erase(const T& key)
+	{
+		page_id leaf = find_leaf(key);
+		Page_Guard page(this, leaf);
+		Page_Header* head = header(page.data());
+		size_t position = lower_index(page.data(), key);
+		if (position == head->count || cmp(key, keys(page.data())[position]))
+			return 0;
+		T* first = keys(page.data());
+		std::memmove(first + position, first + position + 1, (head->count - position - 1) * sizeof(T));
+		--head->count;
+		page.mark_dirty();
+		--meta.count;
+		return 1;
+	}
+
+private:
+	//  Деление полного листа с одновременной вставкой key в позицию position. Всё, что может бросить
+	//    исключение (буфер и закрепление соседнего листа), делается до изменения страниц
+	void split_leaf(char* left, char* right, page_id left_id, page_id right_id, size_t position, const T& key)
+	{
+		std::optional<Page_Guard> next;
+		if (header(left)->next != no_page)
+			next.emplace(this, header(left)->next);
+
+		//  Собираем все ключи вместе с новым во временном буфере и раскладываем пополам
+		std::vector<T> all(leaf_capacity + 1);
+		std::memcpy(all.data(), keys(left), position * sizeof(T));
+		std::memcpy(all.data() + position, &key, sizeof(T));
+		std::memcpy(all.data() + position + 1, keys(left) + position, (leaf_capacity - position) * sizeof(T));
+
+		size_t left_count = all.size() / 2;
+		std::memcpy(keys(left), all.data(), left_count * sizeof(T));
+		std::memcpy(keys(right), all.data() + left_count, (all.size() - left_count) * sizeof(T));
+
+		Page_Header* left_head = header(left);
+		Page_Header* right_head = header(right);
+		right_head->leaf = 1;
+		right_head->count = static_cast<std::uint16_t>(all.size() - left_count);
+		left_head->count = static_cast<std::uint16_t>(left_count);
+
+		//  Вставка в двусвязный список листьев
+		right_head->prev = left_id;
+		right_head->next = left_head->next;
+		if (next) {
+			header(next->data())->prev = right_id;
+			next->mark_dirty();
+		}
+		else
+			meta.last_leaf = right_id;
+		left_head->next = right_id;
+	}
+
+	//  Вставка разделителя и ссылки на новую правую страницу после дочерней номер child
+	static void insert_separator(char* page, size_t child, const T& separator, page_id right_page)
+	{
+		Page_Header* head = header(page);
+		T* first = keys(page);
+		page_id* links = children(page);
+		std::memmove(first + child + 1, first + child, (head->count - child) * sizeof(T));
+		std::memcpy(first + child, &separator, sizeof(T));
+		std::memmove(links + child + 2, links + child + 1, (head->count - child) * sizeof(page_id));
+		links[child + 1] = right_page;
+		++head->count;
+	}
+
+	//  Деление полного внутреннего узла со вставкой разделителя. Возвращает средний разделитель,
+	//    который уходит в родителя и не остаётся ни в одной из половин
+	static T split_internal(char* left, char* right, size_t child, const T& separator, page_id right_page)
+	{
+		std::vector<T> all_keys(internal_capacity + 1);
+		std::vector<page_id> all_links(internal_capacity + 2);
+		std::memcpy(all_keys.data(), keys(left), child * sizeof(T));
+		std::memcpy(all_keys.data() + child, &separator, sizeof(T));
+		std::memcpy(all_keys.data() + child + 1, keys(left) + child, (internal_capacity - child) * sizeof(T));
+		std::memcpy(all_links.data(), children(left), (child + 1) * sizeof(page_id));
+		all_links[child + 1] = right_page;
+		std::memcpy(all_links.data() + child + 2, children(left) + child + 1, (internal_capacity - child) * sizeof(page_id));
+
+		size_t middle = all_keys.size() / 2;
+		size_t right_count = all_keys.size() - middle - 1;
+		std::memcpy(keys(left), all_keys.data(), middle * sizeof(T));
+		std::memcpy(children(left), all_links.data(), (middle + 1) * sizeof(page_id));
+		std::memcpy(keys(right), all_keys.data() + middle + 1, right_count * sizeof(T));
+		std::memcpy(children(right), all_links.data() + middle + 1, (right_count + 1) * sizeof(page_id));
+
+		header(left)->count = static_cast<std::uint16_t>(middle);
+		header(right)->leaf = 0;
+		header(right)->count = static_cast<std::uint16_t>(right_count);
+		return all_keys[middle];
+	}
+};
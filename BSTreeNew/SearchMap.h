@@ -0,0 +1,388 @@
+﻿#pragma once
+
+//  Ассоциативный массив поверх Binary_Search_Tree: в узлах хранятся пары std::pair<const K, V>, упорядоченные
+//    только по ключу. Узлы, их создание, удаление и перестановки – те же, что у дерева; спуск по ключу свой,
+//    без построения пары для сравнения, поэтому поиск и вставка принимают ключ (или, при прозрачном
+//    компараторе вроде std::less<>, любое сравнимое с ключом значение).
+//  Итератор даёт изменяемое значение: it->second можно менять на месте. Обновление счётчика через operator[]
+//    или try_emplace – один спуск от корня и ни одного выделения памяти, если ключ уже есть.
+
+#include "BStree.h"
+#include <utility>
+#include <tuple>
+#include <stdexcept>
+#include <iterator>
+#include <algorithm>
+#include <functional>
+
+//  Порядок пар в дереве – по ключу
+template<typename K, typename V, class Compare = std::less<K>>
+struct Map_Key_Compare
+{
+	Compare cmp = Compare();
+
+	bool operator()(const std::pair<const K, V>& a, const std::pair<const K, V>& b) const
+	{
+		return cmp(a.first, b.first);
+	}
+};
+
+template<typename K, typename V, class Compare = std::less<K>, class Allocator = std::allocator<std::pair<const K, V>>,
+	class Stats = No_Tree_Stats>
+class Binary_Search_Map : private Binary_Search_Tree<std::pair<const K, V>, Map_Key_Compare<K, V, Compare>, Allocator, Stats>
+{
+	using tree_type = Binary_Search_Tree<std::pair<const K, V>, Map_Key_Compare<K, V, Compare>, Allocator, Stats>;
+	using Node = typename tree_type::Node;
+
+	//  Прозрачный компаратор (с is_transparent) разрешает искать по значениям других типов
+	template<class Key, class = void>
+	struct is_transparent : std::false_type {};
+	template<class Key>
+	struct is_transparent<Key, std::void_t<typename Key::is_transparent>> : std::true_type {};
+
+	template<class Key>
+	using transparent_key = std::enable_if_t<is_transparent<Compare>::value, Key>;
+
+public:
+	using key_type = K;
+	using mapped_type = V;
+	using value_type = std::pair<const K, V>;
+	using key_compare = Compare;
+	using allocator_type = Allocator;
+	using size_type = typename tree_type::size_type;
+	using difference_type = std::ptrdiff_t;
+	using reference = value_type&;
+	using const_reference = const value_type&;
+
+	//  Итератор по парам; Const – только для чтения. Перемещение по дереву – как у итератора дерева
+	template<bool Const>
+	class basic_iterator
+	{
+		friend class Binary_Search_Map;
+		Node* node = nullptr;
+
+		explicit basic_iterator(Node* n) noexcept : node(n) {}
+		explicit basic_iterator(typename tree_type::iterator it) noexcept : node(tree_type::node_of(it)) {}
+		typename tree_type::iterator tree_iterator() const noexcept { return tree_type::make_iterator(node); }
+	public:
+		using iterator_category = std::bidirectional_iterator_tag;
+		using value_type = Binary_Search_Map::value_type;
+		using difference_type = std::ptrdiff_t;
+		using pointer = std::conditional_t<Const, const value_type*, value_type*>;
+		using reference = std::conditional_t<Const, const value_type&, value_type&>;
+
+		basic_iterator() noexcept = default;
+		//  Изменяемый итератор приводится к константному
+		template<bool OtherConst, class = std::enable_if_t<Const && !OtherConst>>
+		basic_iterator(const basic_iterator<OtherConst>& other) noexcept : node(other.node) {}
+
+		reference operator*() const noexcept { return node->data; }
+		pointer operator->() const noexcept { return &node->data; }
+
+		basic_iterator& operator++()
+		{
+			node = tree_type::node_of(++tree_iterator());
+			return *this;
+		}
+		basic_iterator operator++(int)
+		{
+			basic_iterator old(*this);
+			++*this;
+			return old;
+		}
+		basic_iterator& operator--()
+		{
+			node = tree_type::node_of(--tree_iterator());
+			return *this;
+		}
+		basic_iterator operator--(int)
+		{
+			basic_iterator old(*this);
+			--*this;
+			return old;
+		}
+
+		friend bool operator==(const basic_iterator& a, const basic_iterator& b) noexcept { return a.node == b.node; }
+		friend bool operator!=(const basic_iterator& a, const basic_iterator& b) noexcept { return a.node != b.node; }
+
+		template<bool> friend class basic_iterator;
+	};
+
+	using iterator = basic_iterator<false>;
+	using const_iterator = basic_iterator<true>;
+	using reverse_iterator = std::reverse_iterator<iterator>;
+	using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+	Binary_Search_Map(const Compare& comparator = Compare(), const Allocator& alloc = Allocator())
+		: tree_type(Map_Key_Compare<K, V, Compare>{ comparator }, alloc) {}
+
+	explicit Binary_Search_Map(const Allocator& alloc) : tree_type(alloc) {}
+
+	Binary_Search_Map(std::initializer_list<value_type> il, const Compare& comparator = Compare(), const Allocator& alloc = Allocator())
+		: Binary_Search_Map(comparator, alloc)
+	{
+		insert(il.begin(), il.end());
+	}
+
+	template<class InputIterator>
+	Binary_Search_Map(InputIterator first, InputIterator last, const Compare& comparator = Compare(), const Allocator& alloc = Allocator())
+		: Binary_Search_Map(comparator, alloc)
+	{
+		insert(first, last);
+	}
+
+	using tree_type::get_allocator;
+	using tree_type::size;
+	using tree_type::empty;
+	using tree_type::clear;
+	using tree_type::stats;
+	using tree_type::reset_stats;
+	using tree_type::shape_stats;
+	using tree_type::height;
+	using tree_type::rebalance;
+
+	key_compare key_comp() const { return this->comparator().cmp; }
+
+	iterator begin() noexcept { return iterator(tree_type::begin()); }
+	iterator end() noexcept { return iterator(tree_type::end()); }
+	const_iterator begin() const noexcept { return const_iterator(tree_type::begin()); }
+	const_iterator end() const noexcept { return const_iterator(tree_type::end()); }
+	const_iterator cbegin() const noexcept { return begin(); }
+	const_iterator cend() const noexcept { return end(); }
+	reverse_iterator rbegin() noexcept { return reverse_iterator(end()); }
+	reverse_iterator rend() noexcept { return reverse_iterator(begin()); }
+	const_reverse_iterator rbegin() const noexcept { return const_reverse_iterator(end()); }
+	const_reverse_iterator rend() const noexcept { return const_reverse_iterator(begin()); }
+
+	//  Поиск. Перегрузки-шаблоны принимают любые сравнимые с ключом значения и есть только у прозрачного компаратора
+	iterator find(const K& key) { return iterator(find_node(key)); }
+	const_iterator find(const K& key) const { return const_iterator(find_node(key)); }
+	template<class Key, class = transparent_key<Key>>
+	iterator find(const Key& key) { return iterator(find_node(key)); }
+	template<class Key, class = transparent_key<Key>>
+	const_iterator find(const Key& key) const { return const_iterator(find_node(key)); }
+
+	bool contains(const K& key) const { return find_node(key) != this->dummy; }
+	template<class Key, class = transparent_key<Key>>
+	bool contains(const Key& key) const { return find_node(key) != this->dummy; }
+
+	size_type count(const K& key) const { return contains(key) ? 1 : 0; }
+	template<class Key, class = transparent_key<Key>>
+	size_type count(const Key& key) const { return contains(key) ? 1 : 0; }
+
+	//  Первый элемент с ключом не меньше key / больше key
+	iterator lower_bound(const K& key) { return iterator(bound_node<false>(key)); }
+	const_iterator lower_bound(const K& key) const { return const_iterator(bound_node<false>(key)); }
+	template<class Key, class = transparent_key<Key>>
+	iterator lower_bound(const Key& key) { return iterator(bound_node<false>(key)); }
+	template<class Key, class = transparent_key<Key>>
+	const_iterator lower_bound(const Key& key) const { return const_iterator(bound_node<false>(key)); }
+
+	iterator upper_bound(const K& key) { return iterator(bound_node<true>(key)); }
+	const_iterator upper_bound(const K& key) const { return const_iterator(bound_node<true>(key)); }
+	template<class Key, class = transparent_key<Key>>
+	iterator upper_bound(const Key& key) { return iterator(bound_node<true>(key)); }
+	template<class Key, class = transparent_key<Key>>
+	const_iterator upper_bound(const Key& key) const { return const_iterator(bound_node<true>(key)); }
+
+	std::pair<iterator, iterator> equal_range(const K& key) { return { lower_bound(key), upper_bound(key) }; }
+	std::pair<const_iterator, const_iterator> equal_range(const K& key) const { return { lower_bound(key), upper_bound(key) }; }
+	template<class Key, class = transparent_key<Key>>
+	std::pair<iterator, iterator> equal_range(const Key& key) { return { lower_bound(key), upper_bound(key) }; }
+	template<class Key, class = transparent_key<Key>>
+	std::pair<const_iterator, const_iterator> equal_range(const Key& key) const { return { lower_bound(key), upper_bound(key) }; }
+
+	V& at(const K& key)
+	{
+		Node* node = find_node(key);
+		if (node == this->dummy) throw std::out_of_range("Binary_Search_Map::at: no such key");
+		return node->data.second;
+	}
+
+	const V& at(const K& key) const
+	{
+		return const_cast<Binary_Search_Map*>(this)->at(key);
+	}
+
+	//  Значение по ключу; если ключа нет – вставляется значение по умолчанию
+	V& operator[](const K& key) { return try_emplace(key).first->second; }
+	V& operator[](K&& key) { return try_emplace(std::move(key)).first->second; }
+
+	//  Вставка пары (K, V(args...)), если ключа нет; если есть – ничего не делается, args не используются
+	template<class... Args>
+	std::pair<iterator, bool> try_emplace(const K& key, Args&&... args)
+	{
+		return emplace_key(key, std::forward<Args>(args)...);
+	}
+
+	template<class... Args>
+	std::pair<iterator, bool> try_emplace(K&& key, Args&&... args)
+	{
+		return emplace_key(std::move(key), std::forward<Args>(args)...);
+	}
+
+	//  Вставка или замена значения – тоже один спуск
+	template<class M>
+	std::pair<iterator, bool> insert_or_assign(const K& key, M&& value)
+	{
+		return assign_key(key, std::forward<M>(value));
+	}
+
+	template<class M>
+	std::pair<iterator, bool> insert_or_assign(K&& key, M&& value)
+	{
+		return assign_key(std::move(key), std::forward<M>(value));
+	}
+
+	std::pair<iterator, bool> insert(const value_type& value)
+	{
+		return try_emplace(value.first, value.second);
+	}
+
+	std::pair<iterator, bool> insert(value_type&& value)
+	{
+		//  Ключ в паре константный, поэтому переместить можно только значение
+		return try_emplace(value.first, std::move(value.second));
+	}
+
+	template<class InputIterator>
+	void insert(InputIterator first, InputIterator last)
+	{
+		for (; first != last; ++first)
+			insert(*first);
+	}
+
+	iterator erase(const_iterator position)
+	{
+		return iterator(tree_type::erase(position.tree_iterator()));
+	}
+
+	iterator erase(iterator position)
+	{
+		return erase(const_iterator(position));
+	}
+
+	iterator erase(const_iterator first, const_iterator last)
+	{
+		return iterator(tree_type::erase(first.tree_iterator(), last.tree_iterator()));
+	}
+
+	size_type erase(const K& key) { return erase_node(find_node(key)); }
+	template<class Key, class = transparent_key<Key>>
+	size_type erase(const Key& key) { return erase_node(find_node(key)); }
+
+	void swap(Binary_Search_Map& other) noexcept { tree_type::swap(other); }
+
+	friend bool operator==(const Binary_Search_Map& a, const Binary_Search_Map& b)
+	{
+		return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
+	}
+
+	friend bool operator!=(const Binary_Search_Map& a, const Binary_Search_Map& b) { return !(a == b); }
+
+	friend void swap(Binary_Search_Map& a, Binary_Search_Map& b) noexcept { a.swap(b); }
+
+private:
+	size_type erase_node(Node* node)
+	{
+		if (node == this->dummy) return 0;
+		tree_type::erase(tree_type::make_iterator(node));
+		return 1;
+	}
+
+	//  Сравнение искомого ключа с ключом узла: отрицательное – key меньше, 0 – равны, положительное – больше.
+	//    Для ключа того же типа – одно трёхпутевое сравнение (как в дереве), иначе – два вызова cmp
+	template<class Key>
+	int compare_key(const Key& key, const Node* node) const
+	{
+		const Compare& cmp = this->comparator().cmp;
+		this->stats().visited();
+		this->stats().compared();
+		if constexpr (std::is_same_v<Key, K>)
+			return Three_Way_Compare<K, Compare>::compare(cmp, key, node->data.first);
+		else
+			return cmp(key, node->data.first) ? -1 : cmp(node->data.first, key) ? 1 : 0;
+	}
+
+	template<class Key>
+	Node* find_node(const Key& key) const
+	{
+		this->stats().lookup();
+		Node* node = this->dummy->parent;
+		while (node != this->dummy) {
+			int order = compare_key(key, node);
+			if (order == 0) break;
+			node = order < 0 ? node->left : node->right;
+		}
+		return node;
+	}
+
+	//  Upper = false – первый узел не меньше key, true – первый больше key
+	template<bool Upper, class Key>
+	Node* bound_node(const Key& key) const
+	{
+		this->stats().lookup();
+		const Compare& cmp = this->comparator().cmp;
+		Node* node = this->dummy->parent;
+		Node* result = this->dummy;
+		while (node != this->dummy) {
+			this->stats().visited();
+			this->stats().compared();
+			bool go_left = Upper ? cmp(key, node->data.first) : !cmp(node->data.first, key);
+			if (go_left) {
+				result = node;
+				node = node->left;
+			}
+			else
+				node = node->right;
+		}
+		return result;
+	}
+
+	//  Спуск до узла с ключом или до места вставки: возвращает найденный узел (found) или будущего родителя
+	//    и сторону, к которой подвешивается новый узел
+	struct Position
+	{
+		Node* node;
+		bool found;
+		bool to_left;
+	};
+
+	Position locate(const K& key) const
+	{
+		this->stats().lookup();
+		Node* parent = this->dummy;
+		Node* node = this->dummy->parent;
+		int order = 0;
+		while (node != this->dummy) {
+			parent = node;
+			order = compare_key(key, node);
+			if (order == 0) return Position{ node, true, false };
+			node = order < 0 ? node->left : node->right;
+		}
+		return Position{ parent, false, order < 0 };
+	}
+
+	template<class Key, class... Args>
+	std::pair<iterator, bool> emplace_key(Key&& key, Args&&... args)
+	{
+		Position position = locate(key);
+		if (position.found)
+			return { iterator(position.node), false };
+		Node* node = this->link_new_node(position.node, position.to_left, std::piecewise_construct,
+			std::forward_as_tuple(std::forward<Key>(key)), std::forward_as_tuple(std::forward<Args>(args)...));
+		return { iterator(node), true };
+	}
+
+	template<class Key, class M>
+	std::pair<iterator, bool> assign_key(Key&& key, M&& value)
+	{
+		Position position = locate(key);
+		if (position.found) {
+			position.node->data.second = std::forward<M>(value);
+			return { iterator(position.node), false };
+		}
+		Node* node = this->link_new_node(position.node, position.to_left, std::forward<Key>(key), std::forward<M>(value));
+		return { iterator(node), true };
+	}
+};
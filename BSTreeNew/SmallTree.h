@@ -0,0 +1,378 @@
+﻿#pragma once
+
+//  Множество с оптимизацией малого размера: до N ключей хранятся прямо в объекте, в отсортированном массиве,
+//    без фиктивной вершины и без выделения памяти на каждый ключ. Когда ключей становится больше N, они
+//    переносятся в обычное Binary_Search_Tree (сбалансированное построение из отсортированного массива),
+//    и дальше множество работает как дерево. Итераторы одинаковы для обоих режимов.
+//  Обратно в массив множество возвращается только при clear() – чтобы размер, колеблющийся около N,
+//    не вызывал постоянных переносов.
+//  Поиск в массиве для арифметических ключей со стандартным порядком – линейный подсчёт меньших ключей
+//    без ветвлений, который компилятор векторизует; для остальных ключей – двоичный поиск.
+
+#include "BStree.h"
+#include <optional>
+#include <new>
+#include <memory>
+#include <utility>
+#include <iterator>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+#include <initializer_list>
+
+template<typename T, size_t N = 16, class Compare = std::less<T>, class Allocator = std::allocator<T>>
+class Small_Search_Tree
+{
+	static_assert(N > 0, "inline capacity must be positive");
+
+public:
+	using tree_type = Binary_Search_Tree<T, Compare, Allocator>;
+	using key_type = T;
+	using value_type = T;
+	using key_compare = Compare;
+	using allocator_type = Allocator;
+	using size_type = size_t;
+	using difference_type = std::ptrdiff_t;
+	using reference = const T&;
+	using const_reference = const T&;
+
+	//  Константный итератор: в режиме массива – указатель на ключ, в режиме дерева – итератор дерева
+	class iterator
+	{
+		friend class Small_Search_Tree;
+		const T* key = nullptr;
+		typename tree_type::iterator node;
+
+		explicit iterator(const T* k) noexcept : key(k) {}
+		explicit iterator(typename tree_type::iterator it) noexcept : node(it) {}
+	public:
+		using iterator_category = std::bidirectional_iterator_tag;
+		using value_type = T;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const T*;
+		using reference = const T&;
+
+		iterator() noexcept = default;
+
+		const T& operator*() const { return key ? *key : *node; }
+		const T* operator->() const { return &**this; }
+
+		iterator& operator++()
+		{
+			if (key) ++key; else ++node;
+			return *this;
+		}
+
+		iterator operator++(int)
+		{
+			iterator old(*this);
+			++*this;
+			return old;
+		}
+
+		iterator& operator--()
+		{
+			if (key) --key; else --node;
+			return *this;
+		}
+
+		iterator operator--(int)
+		{
+			iterator old(*this);
+			--*this;
+			return old;
+		}
+
+		friend bool operator==(const iterator& a, const iterator& b) { return a.key == b.key && a.node == b.node; }
+		friend bool operator!=(const iterator& a, const iterator& b) { return !(a == b); }
+	};
+
+	using const_iterator = iterator;
+	using reverse_iterator = std::reverse_iterator<iterator>;
+	using const_reverse_iterator = reverse_iterator;
+
+private:
+	Compare cmp = Compare();
+	Allocator alloc = Allocator();
+	//  Число ключей в массиве (в режиме дерева – 0)
+	size_type inline_size = 0;
+	alignas(T) unsigned char storage[N * sizeof(T)];
+	//  Дерево, когда ключей стало больше N
+	std::optional<tree_type> tree;
+
+	T* keys() noexcept { return std::launder(reinterpret_cast<T*>(storage)); }
+	const T* keys() const noexcept { return std::launder(reinterpret_cast<const T*>(storage)); }
+
+	//  Линейный подсчёт подходит для ключей, сравнение которых – одна инструкция
+	static constexpr bool linear_search = std::is_arithmetic_v<T> &&
+		(std::is_same_v<Compare, std::less<T>> || std::is_same_v<Compare, std::less<>> ||
+			std::is_same_v<Compare, std::greater<T>> || std::is_same_v<Compare, std::greater<>>);
+
+	//  Позиция первого ключа массива, не меньшего key (Upper – большего key)
+	template<bool Upper = false>
+	size_type inline_bound(const T& key) const
+	{
+		const T* first = keys();
+		if constexpr (linear_search) {
+			size_type position = 0;
+			for (size_type i = 0; i < inline_size; ++i)
+				position += Upper ? !cmp(key, first[i]) : cmp(first[i], key);
+			return position;
+		}
+		else if constexpr (Upper)
+			return std::upper_bound(first, first + inline_size, key, cmp) - first;
+		else
+			return std::lower_bound(first, first + inline_size, key, cmp) - first;
+	}
+
+	void destroy_inline() noexcept
+	{
+		std::destroy_n(keys(), inline_size);
+		inline_size = 0;
+	}
+
+	//  Перенос ключей массива в дерево; сам новый ключ вставляет вызывающий. Ключи копируются, а не перемещаются,
+	//    и массив разрушается только после построения дерева: при исключении контейнер остаётся прежним
+	void spill()
+	{
+		const T* first = keys();
+		tree.emplace(first, first + inline_size, cmp, alloc);
+		destroy_inline();
+	}
+
+	//  Обмен для случая, когда *this в режиме дерева, а other – в режиме массива. Единственная операция, которая
+	//    может бросить исключение до изменения состояния, – создание пустого дерева для other
+	void swap_with_inline(Small_Search_Tree& other)
+	{
+		other.tree.emplace(other.cmp, other.alloc);
+		try {
+			std::uninitialized_move_n(other.keys(), other.inline_size, keys());
+		}
+		catch (...) {
+			other.tree.reset();
+			throw;
+		}
+		inline_size = other.inline_size;
+		other.destroy_inline();
+		other.tree->swap(*tree);
+		tree.reset();
+	}
+
+	void copy_from(const Small_Search_Tree& other)
+	{
+		if (other.tree)
+			tree.emplace(*other.tree);
+		else {
+			std::uninitialized_copy_n(other.keys(), other.inline_size, keys());
+			inline_size = other.inline_size;
+		}
+	}
+
+	//  Перенос дерева выделяет новую фиктивную вершину для покинутого дерева, поэтому перемещение не бросает
+	//    исключений, только если этого не делает и перемещение дерева
+	static constexpr bool nothrow_move = std::is_nothrow_move_constructible_v<T> && std::is_nothrow_move_constructible_v<tree_type>;
+
+	void move_from(Small_Search_Tree& other) noexcept(nothrow_move)
+	{
+		if (other.tree) {
+			tree.emplace(std::move(*other.tree));
+			other.tree.reset();
+		}
+		else {
+			std::uninitialized_move_n(other.keys(), other.inline_size, keys());
+			inline_size = other.inline_size;
+			other.destroy_inline();
+		}
+	}
+
+public:
+	Small_Search_Tree(const Compare& comparator = Compare(), const Allocator& allocator = Allocator())
+		: cmp(comparator), alloc(allocator) {}
+
+	Small_Search_Tree(std::initializer_list<T> il, const Compare& comparator = Compare(), const Allocator& allocator = Allocator())
+		: Small_Search_Tree(comparator, allocator)
+	{
+		insert(il.begin(), il.end());
+	}
+
+	template<class InputIterator>
+	Small_Search_Tree(InputIterator first, InputIterator last, const Compare& comparator = Compare(), const Allocator& allocator = Allocator())
+		: Small_Search_Tree(comparator, allocator)
+	{
+		insert(first, last);
+	}
+
+	Small_Search_Tree(const Small_Search_Tree& other) : cmp(other.cmp), alloc(other.alloc)
+	{
+		copy_from(other);
+	}
+
+	Small_Search_Tree(Small_Search_Tree&& other) noexcept(nothrow_move)
+		: cmp(other.cmp), alloc(other.alloc)
+	{
+		move_from(other);
+	}
+
+	Small_Search_Tree& operator=(const Small_Search_Tree& other)
+	{
+		if (this != &other) {
+			Small_Search_Tree copy(other);
+			clear();
+			cmp = copy.cmp;
+			move_from(copy);
+		}
+		return *this;
+	}
+
+	Small_Search_Tree& operator=(Small_Search_Tree&& other) noexcept(nothrow_move)
+	{
+		if (this != &other) {
+			clear();
+			cmp = other.cmp;
+			move_from(other);
+		}
+		return *this;
+	}
+
+	~Small_Search_Tree() { destroy_inline(); }
+
+	//  Хранятся ли ключи в узлах дерева (а не в массиве внутри объекта)
+	bool spilled() const noexcept { return tree.has_value(); }
+	static constexpr size_type inline_capacity() noexcept { return N; }
+
+	size_type size() const noexcept { return tree ? tree->size() : inline_size; }
+	bool empty() const noexcept { return size() == 0; }
+	key_compare key_comp() const { return cmp; }
+	allocator_type get_allocator() const { return alloc; }
+
+	iterator begin() const { return tree ? iterator(tree->begin()) : iterator(keys()); }
+	iterator end() const { return tree ? iterator(tree->end()) : iterator(keys() + inline_size); }
+	iterator cbegin() const { return begin(); }
+	iterator cend() const { return end(); }
+	reverse_iterator rbegin() const { return reverse_iterator(end()); }
+	reverse_iterator rend() const { return reverse_iterator(begin()); }
+
+	iterator lower_bound(const T& key) const
+	{
+		return tree ? iterator(tree->lower_bound(key)) : iterator(keys() + inline_bound(key));
+	}
+
+	iterator upper_bound(const T& key) const
+	{
+		return tree ? iterator(tree->upper_bound(key)) : iterator(keys() + inline_bound<true>(key));
+	}
+
+	std::pair<iterator, iterator> equal_range(const T& key) const
+	{
+		return { lower_bound(key), upper_bound(key) };
+	}
+
+	iterator find(const T& key) const
+	{
+		if (tree) return iterator(tree->find(key));
+		size_type position = inline_bound(key);
+		if (position != inline_size && !cmp(key, keys()[position]))
+			return iterator(keys() + position);
+		return end();
+	}
+
+	bool contains(const T& key) const { return find(key) != end(); }
+	size_type count(const T& key) const { return contains(key) ? 1 : 0; }
+
+	std::pair<iterator, bool> insert(const T& key)
+	{
+		if (tree) {
+			auto result = tree->insert(key);
+			return { iterator(result.first), result.second };
+		}
+		size_type position = inline_bound(key);
+		T* first = keys();
+		if (position != inline_size && !cmp(key, first[position]))
+			return { iterator(first + position), false };
+		if (inline_size == N) {
+			spill();
+			auto result = tree->insert(key);
+			return { iterator(result.first), result.second };
+		}
+		//  Сдвиг хвоста на одну позицию: последний ключ переносится в свободную ячейку, остальные – присваиванием
+		if (position == inline_size)
+			::new (static_cast<void*>(first + position)) T(key);
+		else {
+			T copy(key);
+			::new (static_cast<void*>(first + inline_size)) T(std::move(first[inline_size - 1]));
+			std::move_backward(first + position, first + inline_size - 1, first + inline_size);
+			first[position] = std::move(copy);
+		}
+		++inline_size;
+		return { iterator(first + position), true };
+	}
+
+	template<class InputIterator>
+	void insert(InputIterator first, InputIterator last)
+	{
+		for (; first != last; ++first)
+			insert(*first);
+	}
+
+	void insert(std::initializer_list<T> il) { insert(il.begin(), il.end()); }
+
+	iterator erase(iterator position)
+	{
+		if (tree) return iterator(tree->erase(position.node));
+		T* first = keys();
+		T* target = const_cast<T*>(position.key);
+		std::move(target + 1, first + inline_size, target);
+		std::destroy_at(first + inline_size - 1);
+		--inline_size;
+		return iterator(target);
+	}
+
+	size_type erase(const T& key)
+	{
+		iterator it = find(key);
+		if (it == end()) return 0;
+		erase(it);
+		return 1;
+	}
+
+	//  Очистка возвращает множество в режим массива
+	void clear() noexcept
+	{
+		destroy_inline();
+		tree.reset();
+	}
+
+	//  Обмен по членам, без промежуточного объекта: два дерева обмениваются корнями без выделений, два массива –
+	//    ключами; если в дереве только одно из множеств, то второму заводится пустое дерево (одно выделение),
+	//    а ключи массива переносятся на место, освободившееся от дерева
+	void swap(Small_Search_Tree& other)
+	{
+		if (tree && other.tree)
+			tree->swap(*other.tree);
+		else if (tree)
+			swap_with_inline(other);
+		else if (other.tree)
+			other.swap_with_inline(*this);
+		else {
+			Small_Search_Tree& longer = inline_size < other.inline_size ? other : *this;
+			Small_Search_Tree& shorter = inline_size < other.inline_size ? *this : other;
+			size_type common = shorter.inline_size;
+			std::swap_ranges(keys(), keys() + common, other.keys());
+			std::uninitialized_move(longer.keys() + common, longer.keys() + longer.inline_size, shorter.keys() + common);
+			std::destroy(longer.keys() + common, longer.keys() + longer.inline_size);
+			std::swap(inline_size, other.inline_size);
+		}
+		using std::swap;
+		swap(cmp, other.cmp);
+		swap(alloc, other.alloc);
+	}
+
+	friend bool operator==(const Small_Search_Tree& a, const Small_Search_Tree& b)
+	{
+		return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
+	}
+
+	friend bool operator!=(const Small_Search_Tree& a, const Small_Search_Tree& b) { return !(a == b); }
+
+	friend void swap(Small_Search_Tree& a, Small_Search_Tree& b) { a.swap(b); }
+};
@@ -13,7 +13,7 @@ using namespace std;
 template<typename InputIter>
 void print(InputIter first, InputIter last) {
 
-	if (std::is_same<iterator_traits<InputIter>::iterator_category, std::random_access_iterator_tag>::value) {
+	if (std::is_same<typename iterator_traits<InputIter>::iterator_category, std::random_access_iterator_tag>::value) {
 		cout << "Random access iterator range : ";
 		while (first != last)
 			cout << *first++ << " ";
@@ -0,0 +1,188 @@
+﻿#pragma once
+
+//  Неизменяемое упорядоченное множество, построенное на этапе компиляции. Ключи хранятся в массиве в порядке
+//    Эйтцингера (как куча): корень – элемент 1, дочерние узла k – элементы 2k и 2k+1 (нумерация с единицы).
+//    Это идеально сбалансированное неявное дерево без указателей: спуск к дочернему – арифметика над индексом,
+//    верхние уровни лежат рядом и остаются в кэше. Узлов не выделяется, а constexpr-объект целиком
+//    помещается компилятором в данные только для чтения – ни работы при запуске, ни кучи.
+//  Поиск, границы и обход по возрастанию – constexpr, их можно использовать и в static_assert, и во время работы.
+//  Пример:
+//    constexpr auto keywords = make_static_set<std::string_view>({ "if", "else", "while", "for" });
+//    static_assert(keywords.contains("while"));
+//  Повторяющиеся ключи – ошибка компиляции (при вычислении в константном выражении).
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <iterator>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+template<typename T, size_t N, class Compare = std::less<T>>
+class Static_Search_Set
+{
+	Compare cmp = Compare();
+	//  keys[0] не используется, корень – keys[1]
+	std::array<T, N + 1> keys{};
+
+	//  Следующий и предыдущий по порядку узел неявного дерева; 0 – за последним (перед первым)
+	static constexpr size_t leftmost(size_t k) noexcept
+	{
+		while (2 * k <= N) k = 2 * k;
+		return k;
+	}
+
+	static constexpr size_t rightmost(size_t k) noexcept
+	{
+		while (2 * k + 1 <= N) k = 2 * k + 1;
+		return k;
+	}
+
+	static constexpr size_t next(size_t k) noexcept
+	{
+		if (2 * k + 1 <= N) return leftmost(2 * k + 1);
+		//  Поднимаемся, пока приходим из правого дочернего, затем ещё на уровень
+		return k >> (std::countr_one(k) + 1);
+	}
+
+	static constexpr size_t prev(size_t k) noexcept
+	{
+		if (k == 0) return N ? rightmost(1) : 0;
+		if (2 * k <= N) return rightmost(2 * k);
+		return k >> (std::countr_zero(k) + 1);
+	}
+
+	//  Спуск без ветвлений: на каждом уровне к индексу добавляется бит «ключ узла меньше искомого» (для
+	//    upper_bound – «не больше»). После выхода за массив хвост из единиц – шаги вправо после последнего
+	//    шага влево; отбросив их и этот шаг, получаем узел, где ушли влево, – ответ (0, если такого нет)
+	template<bool Upper>
+	constexpr size_t bound(const T& key) const
+	{
+		size_t k = 1;
+		while (k <= N) {
+			bool right = Upper ? !cmp(key, keys[k]) : cmp(keys[k], key);
+			k = 2 * k + right;
+		}
+		return k >> (std::countr_one(k) + 1);
+	}
+
+public:
+	using key_type = T;
+	using value_type = T;
+	using size_type = size_t;
+	using difference_type = std::ptrdiff_t;
+	using key_compare = Compare;
+	using const_reference = const T&;
+	using reference = const T&;
+
+	class iterator
+	{
+		friend class Static_Search_Set;
+		const Static_Search_Set* set = nullptr;
+		size_t node = 0;
+
+		constexpr iterator(const Static_Search_Set* s, size_t k) noexcept : set(s), node(k) {}
+	public:
+		using iterator_category = std::bidirectional_iterator_tag;
+		using value_type = T;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const T*;
+		using reference = const T&;
+
+		constexpr iterator() noexcept = default;
+
+		constexpr const T& operator*() const noexcept { return set->keys[node]; }
+		constexpr const T* operator->() const noexcept { return &set->keys[node]; }
+
+		constexpr iterator& operator++() noexcept
+		{
+			node = next(node);
+			return *this;
+		}
+
+		constexpr iterator operator++(int) noexcept
+		{
+			iterator old(*this);
+			++*this;
+			return old;
+		}
+
+		constexpr iterator& operator--() noexcept
+		{
+			node = prev(node);
+			return *this;
+		}
+
+		constexpr iterator operator--(int) noexcept
+		{
+			iterator old(*this);
+			--*this;
+			return old;
+		}
+
+		friend constexpr bool operator==(const iterator& a, const iterator& b) noexcept { return a.node == b.node; }
+		friend constexpr bool operator!=(const iterator& a, const iterator& b) noexcept { return a.node != b.node; }
+	};
+
+	using const_iterator = iterator;
+	using reverse_iterator = std::reverse_iterator<iterator>;
+	using const_reverse_iterator = reverse_iterator;
+
+	//  Ключи сортируются (std::sort – constexpr с C++20) и раскладываются в порядке Эйтцингера:
+	//    обход неявного дерева по возрастанию получает ключи подряд из отсортированного массива
+	constexpr Static_Search_Set(const std::array<T, N>& source, const Compare& comparator = Compare())
+		: cmp(comparator)
+	{
+		std::array<T, N> sorted = source;
+		std::sort(sorted.begin(), sorted.end(), cmp);
+		for (size_t i = 1; i < N; ++i)
+			if (!cmp(sorted[i - 1], sorted[i]))
+				throw std::invalid_argument("Static_Search_Set: duplicate keys");
+		size_t k = leftmost(1);
+		for (size_t i = 0; i < N; ++i, k = next(k))
+			keys[k] = sorted[i];
+	}
+
+	constexpr iterator begin() const noexcept { return iterator(this, N ? leftmost(1) : 0); }
+	constexpr iterator end() const noexcept { return iterator(this, 0); }
+	constexpr iterator cbegin() const noexcept { return begin(); }
+	constexpr iterator cend() const noexcept { return end(); }
+	constexpr reverse_iterator rbegin() const noexcept { return reverse_iterator(end()); }
+	constexpr reverse_iterator rend() const noexcept { return reverse_iterator(begin()); }
+
+	constexpr size_type size() const noexcept { return N; }
+	constexpr bool empty() const noexcept { return N == 0; }
+	constexpr key_compare key_comp() const { return cmp; }
+
+	//  Первый элемент, не меньший key / больший key
+	constexpr iterator lower_bound(const T& key) const { return iterator(this, bound<false>(key)); }
+	constexpr iterator upper_bound(const T& key) const { return iterator(this, bound<true>(key)); }
+
+	constexpr iterator find(const T& key) const
+	{
+		size_t k = bound<false>(key);
+		return k != 0 && !cmp(key, keys[k]) ? iterator(this, k) : end();
+	}
+
+	constexpr bool contains(const T& key) const { return find(key) != end(); }
+	constexpr size_type count(const T& key) const { return contains(key) ? 1 : 0; }
+
+	constexpr std::pair<iterator, iterator> equal_range(const T& key) const
+	{
+		return { lower_bound(key), upper_bound(key) };
+	}
+};
+
+template<typename T, size_t N>
+Static_Search_Set(const std::array<T, N>&) -> Static_Search_Set<T, N>;
+
+//  Построение из списка ключей; тип ключа обычно указывается явно, например, make_static_set<std::string_view>({ ... })
+template<typename T, class Compare = std::less<T>, size_t N>
+constexpr Static_Search_Set<T, N, Compare> make_static_set(const T (&keys)[N], const Compare& comparator = Compare())
+{
+	std::array<T, N> source{};
+	for (size_t i = 0; i < N; ++i)
+		source[i] = keys[i];
+	return Static_Search_Set<T, N, Compare>(source, comparator);
+}
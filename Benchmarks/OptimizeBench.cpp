@@ -0,0 +1,138 @@
+﻿//  Замер перестройки дерева под распределение обращений (Binary_Search_Tree::optimize).
+//  Дерево строится из ключей в случайном порядке, затем одна и та же трасса поисков прогоняется на трёх стадиях:
+//    initial – исходное дерево, rebalance – идеально сбалансированное (rebalance), optimize – перестроенное
+//    по частотам ключей в трассе. Для каждой стадии – высота, средняя глубина поиска по трассе и пропускная
+//    способность find.
+//  Трасса либо читается из файла (--trace: по ключу на строку, ключи дерева – все различные ключи трассы),
+//    либо генерируется: --keys случайных ключей, --lookups поисков с распределением Zipf (--skew).
+//  Результат – CSV в стандартный вывод. Если результаты поиска на стадиях расходятся, программа завершается с кодом 1.
+//  Параметры: --keys N (100000) --lookups N (1000000) --skew S (0.99) --seed N (1) --trace path
+
+#include "../BSTreeNew/BStree.h"
+#include "ZipfGenerator.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <algorithm>
+
+namespace {
+
+	using Clock = std::chrono::steady_clock;
+	using Key = std::uint64_t;
+	using Tree = Binary_Search_Tree<Key>;
+
+	struct Stage
+	{
+		size_t height;
+		double expected_depth;
+		double seconds;
+		std::uint64_t checksum;
+	};
+
+	Stage measure(const Tree& tree, const std::vector<Key>& trace, const std::unordered_map<Key, double>& frequency)
+	{
+		Stage stage{};
+		stage.height = tree.height();
+		stage.expected_depth = tree.expected_depth([&frequency](Key key) {
+			auto it = frequency.find(key);
+			return it != frequency.end() ? it->second : 0.0;
+		});
+		auto start = Clock::now();
+		for (Key key : trace)
+			stage.checksum += tree.find(key) != tree.end();
+		stage.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		return stage;
+	}
+
+	void report(const char* name, const Tree& tree, const std::vector<Key>& trace, const Stage& stage)
+	{
+		std::printf("%s,%zu,%zu,%zu,%.3f,%.6f,%.0f\n", name, tree.size(), trace.size(), stage.height, stage.expected_depth,
+			stage.seconds, stage.seconds > 0 ? trace.size() / stage.seconds : 0.0);
+		std::fflush(stdout);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	size_t keys_count = 100000, lookups = 1000000;
+	double skew = 0.99;
+	unsigned seed = 1;
+	std::string trace_path;
+	for (int i = 1; i + 1 < argc; i += 2) {
+		if (!std::strcmp(argv[i], "--keys")) keys_count = std::strtoull(argv[i + 1], nullptr, 10);
+		else if (!std::strcmp(argv[i], "--lookups")) lookups = std::strtoull(argv[i + 1], nullptr, 10);
+		else if (!std::strcmp(argv[i], "--skew")) skew = std::strtod(argv[i + 1], nullptr);
+		else if (!std::strcmp(argv[i], "--seed")) seed = static_cast<unsigned>(std::strtoul(argv[i + 1], nullptr, 10));
+		else if (!std::strcmp(argv[i], "--trace")) trace_path = argv[i + 1];
+		else {
+			std::fprintf(stderr, "unknown option %s\n", argv[i]);
+			return 2;
+		}
+	}
+
+	std::mt19937_64 random(seed);
+	std::vector<Key> keys, trace;
+	if (!trace_path.empty()) {
+		std::ifstream in(trace_path);
+		if (!in) {
+			std::fprintf(stderr, "cannot open %s\n", trace_path.c_str());
+			return 2;
+		}
+		for (Key key; in >> key;)
+			trace.push_back(key);
+		keys = trace;
+		std::sort(keys.begin(), keys.end());
+		keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+	}
+	else {
+		keys.resize(keys_count);
+		for (Key& key : keys) key = random();
+		//  Горячие ранги Zipf соответствуют случайным ключам, а не наименьшим
+		std::vector<Key> by_rank = keys;
+		std::shuffle(by_rank.begin(), by_rank.end(), random);
+		Zipf_Generator zipf(by_rank.size(), skew);
+		trace.resize(lookups);
+		for (Key& key : trace) key = by_rank[zipf(random)];
+	}
+	std::shuffle(keys.begin(), keys.end(), random);
+
+	std::unordered_map<Key, double> frequency;
+	for (Key key : trace)
+		frequency[key] += 1;
+
+	Tree tree;
+	for (Key key : keys)
+		tree.insert(key);
+
+	std::printf("stage,elements,lookups,height,expected_depth,seconds,lookups_per_sec\n");
+	Stage initial = measure(tree, trace, frequency);
+	report("initial", tree, trace, initial);
+
+	tree.rebalance();
+	Stage balanced = measure(tree, trace, frequency);
+	report("rebalance", tree, trace, balanced);
+
+	auto start = Clock::now();
+	tree.optimize([&frequency](Key key) {
+		auto it = frequency.find(key);
+		return it != frequency.end() ? it->second : 0.0;
+	});
+	double optimize_seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	Stage optimized = measure(tree, trace, frequency);
+	report("optimize", tree, trace, optimized);
+	std::fprintf(stderr, "optimize took %.3f s\n", optimize_seconds);
+
+	if (initial.checksum != balanced.checksum || initial.checksum != optimized.checksum || !tree.CheckTree()) {
+		std::fprintf(stderr, "results differ between stages\n");
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,87 @@
+﻿//  Замер пропускной способности Paged_Search_Tree при росте рабочего множества относительно буферного пула.
+//  Для каждого размера дерево строится заново в файле, затем замеряются вставка случайных ключей,
+//    случайный поиск и полный последовательный просмотр. Результат – CSV в стандартный вывод.
+//  Параметры: [размер пула в МБ = 16] [максимальное число ключей = 16M] [файл дерева = paged_bench.bin]
+
+#include "../BSTreeNew/PagedTree.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+	using Clock = std::chrono::steady_clock;
+
+	double seconds_since(Clock::time_point start)
+	{
+		return std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+}
+
+int main(int argc, char* argv[])
+{
+	size_t pool_mb = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 16;
+	size_t max_keys = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : (16u << 20);
+	std::string path = argc > 3 ? argv[3] : "paged_bench.bin";
+	const size_t pool_bytes = pool_mb << 20;
+	const size_t lookups = 1u << 20;
+
+	std::printf("keys,data_mb,pool_mb,insert_ops_per_sec,find_ops_per_sec,scan_keys_per_sec,hit_rate\n");
+	for (size_t keys = 1u << 16; keys <= max_keys; keys *= 2) {
+		std::mt19937_64 random(keys);
+		Paged_Search_Tree<std::uint64_t> tree(pool_bytes);
+		if (!tree.open(path, true)) {
+			std::fprintf(stderr, "cannot open %s\n", path.c_str());
+			return 1;
+		}
+
+		std::vector<std::uint64_t> values(keys);
+		for (auto& value : values)
+			value = random();
+
+		auto start = Clock::now();
+		for (std::uint64_t value : values)
+			tree.insert(value);
+		double insert_time = seconds_since(start);
+
+		//  Статистику пула считаем только на поиске – именно там видно, помещается ли дерево в память
+		auto before = tree.pool_stats();
+		std::uniform_int_distribution<size_t> position(0, keys - 1);
+		size_t found = 0;
+		start = Clock::now();
+		for (size_t i = 0; i < lookups; ++i)
+			found += tree.count(values[position(random)]);
+		double find_time = seconds_since(start);
+		auto after = tree.pool_stats();
+
+		start = Clock::now();
+		std::uint64_t checksum = 0;
+		size_t scanned = 0;
+		for (auto it = tree.begin(); it != tree.end(); ++it, ++scanned)
+			checksum ^= *it;
+		double scan_time = seconds_since(start);
+
+		size_t accesses = (after.hits - before.hits) + (after.misses - before.misses);
+		std::printf("%zu,%.1f,%zu,%.0f,%.0f,%.0f,%.4f\n", keys,
+			static_cast<double>(keys * sizeof(std::uint64_t)) / (1u << 20), pool_mb,
+			keys / insert_time, lookups / find_time, scanned / scan_time,
+			accesses ? static_cast<double>(after.hits - before.hits) / accesses : 1.0);
+		std::fflush(stdout);
+		//  Проверка результата заодно не даёт компилятору выбросить поиск и просмотр
+		if (found != lookups || scanned != tree.size() || checksum == 1) {
+			std::fprintf(stderr, "unexpected result: %zu keys\n", keys);
+			return 1;
+		}
+		if (!tree.close()) {
+			std::fprintf(stderr, "cannot write %s\n", path.c_str());
+			return 1;
+		}
+	}
+	std::remove(path.c_str());
+	return 0;
+}
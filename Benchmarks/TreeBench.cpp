@@ -0,0 +1,290 @@
+﻿//  Сравнительный замер Binary_Search_Tree и std::set на одинаковых данных.
+//  Операции: insert, find, lower_bound, iterate, for_each, parallel_reduce, append, copy, clear, erase. Распределения ключей: sorted, reverse, random,
+//    zipf (повторяющиеся «горячие» ключи) и clustered (плотные группы подряд идущих ключей).
+//  Память считается распределителем-счётчиком, через который оба контейнера выделяют узлы.
+//  Результат – CSV в стандартный вывод, по строке на (контейнер, распределение, размер, операция):
+//    ops_per_sec – пропускная способность, p50/p90/p99/p999 – задержка отдельной операции в наносекундах
+//    (по выборке операций; для операций над всем контейнером не заполняются), bytes_per_element – память после вставки.
+//  Результаты обоих контейнеров сверяются; при расхождении программа завершается с кодом 1.
+//  Несбалансированное дерево на монотонных ключах (sorted, reverse) вырождается в список, и каждая операция
+//    становится линейной, поэтому для них размер ограничен отдельно.
+//  Параметры: --min N (1000) --max N (1000000) --max-sorted N (10000) --seed N (1)
+
+#include "../BSTreeNew/BStree.h"
+#include "ZipfGenerator.h"
+#include <set>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <numeric>
+
+namespace {
+
+	using Clock = std::chrono::steady_clock;
+
+	//  Счётчики распределителя. Копирование дерева может идти в нескольких потоках, поэтому счётчики атомарные
+	struct Allocation_Stats
+	{
+		static inline std::atomic<std::int64_t> bytes{ 0 };
+	};
+
+	//  Распределитель без состояния, считающий выделенные байты. is_always_equal сохраняет параллельные пути дерева
+	template<typename T>
+	struct Counting_Allocator
+	{
+		using value_type = T;
+		using is_always_equal = std::true_type;
+
+		Counting_Allocator() = default;
+		template<typename U>
+		Counting_Allocator(const Counting_Allocator<U>&) noexcept {}
+
+		T* allocate(size_t n)
+		{
+			Allocation_Stats::bytes += static_cast<std::int64_t>(n * sizeof(T));
+			return std::allocator<T>().allocate(n);
+		}
+
+		void deallocate(T* p, size_t n) noexcept
+		{
+			Allocation_Stats::bytes -= static_cast<std::int64_t>(n * sizeof(T));
+			std::allocator<T>().deallocate(p, n);
+		}
+
+		template<typename U>
+		bool operator==(const Counting_Allocator<U>&) const noexcept { return true; }
+		template<typename U>
+		bool operator!=(const Counting_Allocator<U>&) const noexcept { return false; }
+	};
+
+	using Key = std::uint64_t;
+	using Bench_Tree = Binary_Search_Tree<Key, std::less<Key>, Counting_Allocator<Key>>;
+	using Bench_Set = std::set<Key, std::less<Key>, Counting_Allocator<Key>>;
+
+	//  Перемешивание номера в ключ, чтобы «горячие» ключи Zipf и кластеры были разбросаны по всему диапазону
+	Key mix(Key x)
+	{
+		x += 0x9E3779B97F4A7C15ull;
+		x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+		x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+		return x ^ (x >> 31);
+	}
+
+	const char* const distributions[] = { "sorted", "reverse", "random", "zipf", "clustered" };
+
+	std::vector<Key> make_keys(const std::string& distribution, size_t n, std::mt19937_64& random)
+	{
+		std::vector<Key> keys(n);
+		if (distribution == "sorted")
+			for (size_t i = 0; i < n; ++i) keys[i] = i;
+		else if (distribution == "reverse")
+			for (size_t i = 0; i < n; ++i) keys[i] = n - i;
+		else if (distribution == "random")
+			for (auto& key : keys) key = random();
+		else if (distribution == "zipf") {
+			Zipf_Generator zipf(n, 0.99);
+			for (auto& key : keys) key = mix(zipf(random));
+		}
+		else {
+			//  Группы по 1000 подряд идущих ключей со случайным началом, группы вставляются по очереди
+			const size_t cluster = 1000;
+			for (size_t i = 0; i < n; i += cluster) {
+				Key base = random() >> 1;
+				for (size_t j = i; j < std::min(n, i + cluster); ++j)
+					keys[j] = base + (j - i);
+			}
+		}
+		return keys;
+	}
+
+	struct Measurement
+	{
+		const char* workload;
+		size_t ops;
+		double seconds;
+		std::vector<std::uint32_t> latencies;   //  пусто – операция над всем контейнером
+	};
+
+	struct Run
+	{
+		std::vector<Measurement> measurements;
+		size_t elements = 0;
+		double bytes_per_element = 0;
+		std::uint64_t checksum = 0;
+	};
+
+	//  Замер по одной операции на элемент: задержка засекается у каждой stride-й операции
+	template<class Operation>
+	Measurement measure_each(const char* name, size_t ops, Operation op)
+	{
+		Measurement result{ name, ops, 0, {} };
+		size_t stride = std::max<size_t>(1, ops / 200000);
+		result.latencies.reserve(ops / stride + 1);
+		auto start = Clock::now();
+		for (size_t i = 0; i < ops; ++i) {
+			if (i % stride == 0) {
+				auto before = Clock::now();
+				op(i);
+				result.latencies.push_back(static_cast<std::uint32_t>(
+					std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - before).count()));
+			}
+			else
+				op(i);
+		}
+		result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		return result;
+	}
+
+	template<class Operation>
+	Measurement measure_bulk(const char* name, size_t ops, Operation op)
+	{
+		auto start = Clock::now();
+		op();
+		return Measurement{ name, ops, std::chrono::duration<double>(Clock::now() - start).count(), {} };
+	}
+
+	template<class Container>
+	Run run_workloads(const std::vector<Key>& keys, const std::vector<Key>& probes)
+	{
+		Run run;
+		std::int64_t bytes_before = Allocation_Stats::bytes;
+		Container container;
+
+		run.measurements.push_back(measure_each("insert", keys.size(), [&](size_t i) {
+			run.checksum += container.insert(keys[i]).second;
+		}));
+		run.elements = container.size();
+		run.bytes_per_element = static_cast<double>(Allocation_Stats::bytes - bytes_before) / std::max<size_t>(1, run.elements);
+
+		run.measurements.push_back(measure_each("find", probes.size(), [&](size_t i) {
+			run.checksum += container.find(keys[probes[i]]) != container.end();
+		}));
+
+		run.measurements.push_back(measure_each("lower_bound", probes.size(), [&](size_t i) {
+			//  Ключ, которого обычно нет в контейнере, – поиск заканчивается в листе
+			auto it = container.lower_bound(keys[probes[i]] + 1);
+			run.checksum += it != container.end() ? *it : 0;
+		}));
+
+		run.measurements.push_back(measure_bulk("iterate", run.elements, [&]() {
+			for (Key key : container)
+				run.checksum += key;
+		}));
+
+		//  Внутренний обход дерева; у std::set его нет – для сравнения тот же проход std::for_each
+		run.measurements.push_back(measure_bulk("for_each", run.elements, [&]() {
+			auto add = [&](Key key) { run.checksum += key; };
+			if constexpr (requires { container.for_each(add); })
+				container.for_each(add);
+			else
+				std::for_each(container.begin(), container.end(), add);
+		}));
+
+		//  Сумма ключей во всех потоках; std::set обходится последовательно
+		run.measurements.push_back(measure_bulk("parallel_reduce", run.elements, [&]() {
+			if constexpr (requires { container.parallel_reduce(Key(0), std::plus<Key>(), std::plus<Key>()); })
+				run.checksum += container.parallel_reduce(Key(0), std::plus<Key>(), std::plus<Key>());
+			else
+				run.checksum += std::accumulate(container.begin(), container.end(), Key(0));
+		}));
+
+		//  Заполнение новым контейнером в порядке возрастания; std::set – вставкой с подсказкой end()
+		std::vector<Key> ascending(container.begin(), container.end());
+		Container appended;
+		run.measurements.push_back(measure_each("append", ascending.size(), [&](size_t i) {
+			if constexpr (requires { appended.append(ascending[i]); })
+				appended.append(ascending[i]);
+			else
+				appended.insert(appended.end(), ascending[i]);
+		}));
+		run.checksum += appended.size();
+
+		std::unique_ptr<Container> copy;
+		run.measurements.push_back(measure_bulk("copy", run.elements, [&]() {
+			copy = std::make_unique<Container>(container);
+		}));
+		run.checksum += copy->size();
+		run.measurements.push_back(measure_bulk("clear", run.elements, [&]() { copy->clear(); }));
+
+		run.measurements.push_back(measure_each("erase", probes.size(), [&](size_t i) {
+			run.checksum += container.erase(keys[probes[i]]);
+		}));
+		return run;
+	}
+
+	double percentile(std::vector<std::uint32_t>& sorted, double p)
+	{
+		size_t index = static_cast<size_t>(p * (sorted.size() - 1));
+		return sorted[index];
+	}
+
+	void report(const char* container, const std::string& distribution, size_t size, Run& run)
+	{
+		for (Measurement& m : run.measurements) {
+			std::printf("%s,%s,%zu,%zu,%s,%zu,%.6f,%.0f,", container, distribution.c_str(), size, run.elements,
+				m.workload, m.ops, m.seconds, m.seconds > 0 ? m.ops / m.seconds : 0.0);
+			if (m.latencies.empty())
+				std::printf(",,,,");
+			else {
+				std::sort(m.latencies.begin(), m.latencies.end());
+				std::printf("%.0f,%.0f,%.0f,%.0f,", percentile(m.latencies, 0.5), percentile(m.latencies, 0.9),
+					percentile(m.latencies, 0.99), percentile(m.latencies, 0.999));
+			}
+			std::printf("%.1f\n", run.bytes_per_element);
+		}
+		std::fflush(stdout);
+	}
+
+	size_t argument(int argc, char* argv[], const char* name, size_t fallback)
+	{
+		for (int i = 1; i + 1 < argc; ++i)
+			if (std::strcmp(argv[i], name) == 0)
+				return std::strtoull(argv[i + 1], nullptr, 10);
+		return fallback;
+	}
+
+}
+
+int main(int argc, char* argv[])
+{
+	size_t min_size = argument(argc, argv, "--min", 1000);
+	size_t max_size = argument(argc, argv, "--max", 1000000);
+	size_t max_sorted = argument(argc, argv, "--max-sorted", 10000);
+	size_t seed = argument(argc, argv, "--seed", 1);
+
+	std::printf("container,distribution,size,elements,workload,ops,seconds,ops_per_sec,p50_ns,p90_ns,p99_ns,p999_ns,bytes_per_element\n");
+	for (size_t size = min_size; size <= max_size; size *= 10)
+		for (const char* distribution : distributions) {
+			bool monotonic = std::strcmp(distribution, "sorted") == 0 || std::strcmp(distribution, "reverse") == 0;
+			if (monotonic && size > max_sorted) {
+				std::fprintf(stderr, "skipped %s, %zu keys: above --max-sorted\n", distribution, size);
+				continue;
+			}
+			std::mt19937_64 random(seed);
+			std::vector<Key> keys = make_keys(distribution, size, random);
+			//  Номера ключей для поиска и удаления – в случайном порядке
+			std::vector<Key> probes(size);
+			for (size_t i = 0; i < size; ++i) probes[i] = i;
+			std::shuffle(probes.begin(), probes.end(), random);
+
+			Run tree = run_workloads<Bench_Tree>(keys, probes);
+			report("Binary_Search_Tree", distribution, size, tree);
+			Run set = run_workloads<Bench_Set>(keys, probes);
+			report("std::set", distribution, size, set);
+
+			if (tree.checksum != set.checksum || tree.elements != set.elements) {
+				std::fprintf(stderr, "results differ from std::set: %s, %zu keys\n", distribution, size);
+				return 1;
+			}
+		}
+	return 0;
+}
@@ -0,0 +1,36 @@
+﻿#pragma once
+
+//  Генератор рангов с распределением Zipf для замеров: ранг 0 – самый «горячий».
+//    Метод Gray et al. («Quickly generating billion-record synthetic databases»): подготовка за O(n),
+//    каждый ранг – за O(1). skew < 1
+
+#include <cmath>
+#include <cstddef>
+#include <random>
+#include <algorithm>
+
+class Zipf_Generator
+{
+	double items, theta, alpha, zetan, eta;
+public:
+	Zipf_Generator(size_t n, double skew) : items(static_cast<double>(n)), theta(skew)
+	{
+		double zeta2 = 1.0 + std::pow(0.5, theta);
+		zetan = 0;
+		for (size_t i = 1; i <= n; ++i)
+			zetan += 1.0 / std::pow(static_cast<double>(i), theta);
+		alpha = 1.0 / (1.0 - theta);
+		eta = (1.0 - std::pow(2.0 / items, 1.0 - theta)) / (1.0 - zeta2 / zetan);
+	}
+
+	//  Ранг из [0, n): при u, близком к 1, формула может дать n из-за округления, поэтому ранг ограничен сверху
+	template<class Random>
+	size_t operator()(Random& random)
+	{
+		double u = std::uniform_real_distribution<double>(0.0, 1.0)(random);
+		double uz = u * zetan;
+		if (uz < 1.0) return 0;
+		if (uz < 1.0 + std::pow(0.5, theta)) return 1;
+		return std::min(static_cast<size_t>(items) - 1, static_cast<size_t>(items * std::pow(eta * u - eta + 1.0, alpha)));
+	}
+};
@@ -1,9 +1,28 @@
 ﻿#include "CppUnitTest.h"
 #include "..\BSTreeNew\BStree.h"
+#include "..\BSTreeNew\FlatCombiningTree.h"
+#include "..\BSTreeNew\MappedTree.h"
+#include "..\BSTreeNew\DurableTree.h"
+#include "..\BSTreeNew\PagedTree.h"
+#include "..\BSTreeNew\IntervalTree.h"
+#include "..\BSTreeNew\SearchMap.h"
+#include "..\BSTreeNew\StaticSet.h"
+#include "..\BSTreeNew\SmallTree.h"
+#include "..\BSTreeNew\FlatTree.h"
+#include "..\BSTreeNew\MerkleTree.h"
 #include <set>
 #include <functional>
 #include <memory_resource>
 #include <iterator>
+#include <thread>
+#include <atomic>
+#include <filesystem>
+#include <vector>
+#include <limits>
+#include <string_view>
+#include <sstream>
+#include <cstddef>
+#include <stdexcept>
 
   //Тестирование заголовка <set>, основанное на книге «The C++ Standard Template Library» P.J. Plauger, Alexander A. Stepanov,
   //    Meng Lee, David R. Musser. Немного модифицировано, и разбито на отдельные тесты. 
@@ -54,24 +73,495 @@ namespace TreeTest
 			Binary_Search_Tree<int> Tree2(Tree);
 			Assert::AreEqual(Tree.size(), Tree2.size(), L"Неверно указывается размер после копирования!");
 		}
+
+		TEST_METHOD(ParallelCopyTest)
+		{
+			//  Дерево больше порога параллельного копирования – поддеревья копируются в разных потоках
+			Binary_Search_Tree<int> Tree;
+			for (int i = 0; i < 100000; ++i)
+				Tree.insert(i * 7919 % 100003);
+			Binary_Search_Tree<int> Tree2(Tree);
+			Assert::AreEqual(Tree.size(), Tree2.size(), L"Неверно указывается размер после копирования!");
+			Assert::IsTrue(Tree == Tree2 && Tree2.CheckTree(), L"Копия большого дерева не совпадает с оригиналом!");
+			Assert::IsTrue(*Tree2.begin() == *Tree.begin() && *--Tree2.end() == *--Tree.end(), L"Неверно установлены min и max в копии!");
+			Binary_Search_Tree<int> Tree3;
+			Tree3 = Tree;
+			Assert::IsTrue(Tree3 == Tree, L"Неверно работает оператор присваивания для большого дерева!");
+		}
+
+		//  Ключ, копирование которого бросает исключение, когда исчерпан разрешённый запас копий; ведётся учёт живых объектов.
+		//    Перемещение не бросает и портит исходный ключ – так видно, что ключи были перемещены
+		struct FragileKey
+		{
+			int value;
+			static inline std::atomic<long> copies_left{ -1 };
+			static inline std::atomic<long> alive{ 0 };
+
+			FragileKey(int v) : value(v) { ++alive; }
+			FragileKey(const FragileKey& other) : value(other.value)
+			{
+				if (copies_left.fetch_sub(1) == 0) throw std::runtime_error("copy budget exhausted");
+				++alive;
+			}
+			FragileKey(FragileKey&& other) noexcept : value(std::exchange(other.value, -1)) { ++alive; }
+			FragileKey& operator=(const FragileKey&) = default;
+			FragileKey& operator=(FragileKey&& other) noexcept
+			{
+				value = std::exchange(other.value, -1);
+				return *this;
+			}
+			~FragileKey() { --alive; }
+			bool operator<(const FragileKey& other) const { return value < other.value; }
+		};
+
+		TEST_METHOD(CopyExceptionTest)
+		{
+			//  Исключение при копировании ключа не должно оставлять в памяти уже скопированные узлы – ни при
+			//    последовательном копировании, ни при параллельном, где поддеревья строятся в разных потоках
+			for (int count : { 1000, 100000 }) {
+				Binary_Search_Tree<FragileKey> Tree;
+				for (int i = 0; i < count; ++i)
+					Tree.insert(FragileKey(i * 7919 % 100003));
+				long before = FragileKey::alive;
+				FragileKey::copies_left = count / 2;
+				bool thrown = false;
+				try {
+					Binary_Search_Tree<FragileKey> Copy(Tree);
+				}
+				catch (const std::runtime_error&) {
+					thrown = true;
+				}
+				FragileKey::copies_left = -1;
+				Assert::IsTrue(thrown, L"Исключение при копировании ключа не передано вызывающему");
+				Assert::AreEqual(before, FragileKey::alive.load(), L"После неудачного копирования остались ключи недостроенной копии");
+				Assert::IsTrue(Tree.size() == Binary_Search_Tree<FragileKey>::size_type(count) && Tree.CheckTree(), L"Неудачное копирование повредило исходное дерево");
+			}
+		}
+
+		TEST_METHOD(BulkLoadTest)
+		{
+			//  Построение из неотсортированного диапазона с повторами – должно получиться упорядоченное множество
+			std::vector<int> keys;
+			for (int i = 0; i < 100000; ++i)
+				keys.push_back(i * 7919 % 50021);
+			Binary_Search_Tree<int> Tree(keys.begin(), keys.end());
+			Assert::AreEqual(Tree.size(), Binary_Search_Tree<int>::size_type(50021), L"Повторы не удалены при построении!");
+			Assert::IsTrue(std::is_sorted(Tree.begin(), Tree.end()) && Tree.CheckTree(), L"Дерево построено неверно!");
+			Assert::IsTrue(*Tree.begin() == 0 && *--Tree.end() == 50020, L"Неверно установлены min и max!");
+
+			//  Исключение в конце построения (при создании узлов) не оставляет в памяти уже построенные поддеревья
+			std::vector<FragileKey> fragile(keys.begin(), keys.end());
+			FragileKey::copies_left = std::numeric_limits<long>::max();
+			{
+				Binary_Search_Tree<FragileKey> Built(fragile.begin(), fragile.end());
+			}
+			long before = FragileKey::alive;
+			FragileKey::copies_left = std::numeric_limits<long>::max() - FragileKey::copies_left - 1000;
+			bool thrown = false;
+			try {
+				Binary_Search_Tree<FragileKey> Built(fragile.begin(), fragile.end());
+			}
+			catch (const std::runtime_error&) {
+				thrown = true;
+			}
+			FragileKey::copies_left = -1;
+			Assert::IsTrue(thrown && before == FragileKey::alive, L"После неудачного построения остались ключи");
+		}
+
+		TEST_METHOD(BatchInsertTest)
+		{
+			//  Маленькая пачка вставляется поэлементно, большая – слиянием с перестройкой дерева
+			Binary_Search_Tree<int> Tree;
+			for (int i = 0; i < 10000; ++i)
+				Tree.insert(i * 2);
+			std::vector<int> small_batch = { 7, 3, 19999, 5, 3, 20001 };
+			Tree.insert(small_batch.begin(), small_batch.end());
+			Assert::AreEqual(Tree.size(), Binary_Search_Tree<int>::size_type(10005), L"Неверный размер после вставки маленькой пачки!");
+
+			std::vector<int> big_batch;
+			for (int i = 20000; i >= 0; --i)
+				big_batch.push_back(i);
+			Tree.insert(big_batch.begin(), big_batch.end());
+			Assert::AreEqual(Tree.size(), Binary_Search_Tree<int>::size_type(20002), L"Неверный размер после слияния с большой пачкой!");
+			Assert::IsTrue(std::is_sorted(Tree.begin(), Tree.end()) && Tree.CheckTree(), L"Дерево после слияния некорректно!");
+			Assert::IsTrue(*Tree.begin() == 0 && *--Tree.end() == 20001, L"Неверно установлены min и max!");
+		}
+
+		TEST_METHOD(RangeEraseTest)
+		{
+			//  Удаление диапазона вырезанием поддерева, в том числе с освобождением памяти в фоновом потоке
+			Binary_Search_Tree<int> Tree;
+			for (int i = 0; i < 1000; ++i)
+				Tree.insert(i * 7919 % 1000);
+			auto it = Tree.erase(Tree.find(100), Tree.find(900));
+			Assert::IsTrue(*it == 900 && Tree.size() == 200, L"Неверно удалён диапазон!");
+			Assert::IsTrue(Tree.find(500) == Tree.end() && Tree.find(99) != Tree.end(), L"Неверно удалён диапазон!");
+
+			auto released = Tree.erase_deferred(Tree.begin(), Tree.find(50));
+			Assert::IsTrue(*Tree.begin() == 50 && std::is_sorted(Tree.begin(), Tree.end()) && Tree.CheckTree(), L"Дерево после удаления диапазона некорректно!");
+			Assert::IsTrue(Tree.size() == 150 && released.get() == 50, L"Неверно удалено начало дерева!");
+			//  Результат можно не сохранять: удаление не ждёт фонового потока
+			Tree.erase_deferred(Tree.find(60), Tree.find(70));
+			Assert::IsTrue(Tree.size() == 140 && Tree.find(65) == Tree.end(), L"Неверно удалена середина дерева!");
+
+			Tree.erase(Tree.find(950), Tree.end());
+			Assert::IsTrue(Tree.size() == 90 && *--Tree.end() == 949, L"Неверно удалён конец дерева!");
+		}
+
+		//  Компаратор с трёхпутевым сравнением, подсчитывающий количество вызовов
+		struct CountingCompare3
+		{
+			int* calls;
+			bool operator()(int a, int b) const { ++*calls; return a < b; }
+			int compare3(int a, int b) const { ++*calls; return a < b ? -1 : (b < a ? 1 : 0); }
+		};
+
+		TEST_METHOD(ThreeWayCompareTest)
+		{
+			//  При наличии compare3 спуск делает одно сравнение на уровень
+			int calls = 0;
+			Binary_Search_Tree<int, CountingCompare3> Tree(CountingCompare3{ &calls });
+			Tree.insert(2); Tree.insert(1); Tree.insert(3);
+			calls = 0;
+			Assert::IsTrue(Tree.find(3) != Tree.end() && calls == 2, L"Поиск должен делать одно сравнение на узел!");
+			calls = 0;
+			Assert::IsTrue(!Tree.insert(1).second && calls == 2, L"Вставка должна делать одно сравнение на узел!");
+
+			Binary_Search_Tree<std::string> Strings = { "beta", "alpha", "gamma" };
+			auto range = Strings.equal_range("beta");
+			Assert::IsTrue(*range.first == "beta" && *range.second == "gamma", L"Ошибка метода equal_range");
+			Assert::IsTrue(*Strings.lower_bound("b") == "beta" && Strings.upper_bound("gamma") == Strings.end(), L"Ошибка методов lower_bound/upper_bound");
+		}
+
+		TEST_METHOD(StringPrefixTest)
+		{
+			//  Строки с общим началом длиннее сохраняемого в узле префикса сравниваются целиком
+			Binary_Search_Tree<std::string> Strings = { "abcdefgh1", "abcdefgh2", "abc", "abd", "ab", "b", "abcdefgh" };
+			Assert::IsTrue(Strings.find("abcdefgh2") != Strings.end() && Strings.find("abcdefgh3") == Strings.end(), L"Ошибка поиска строки");
+			Assert::IsTrue(std::is_sorted(Strings.begin(), Strings.end()), L"Неверный порядок строк");
+
+			auto range = Strings.prefix_range("abc");
+			Assert::IsTrue(std::distance(range.first, range.second) == 4, L"Неверный диапазон строк с префиксом abc");
+			Assert::IsTrue(*range.first == "abc" && *range.second == "abd", L"Неверные границы диапазона строк с префиксом");
+			range = Strings.prefix_range("c");
+			Assert::IsTrue(range.first == Strings.end() && range.second == Strings.end(), L"Диапазон для отсутствующего префикса должен быть пустым");
+		}
+
+		TEST_METHOD(StatsTest)
+		{
+			//  Форма дерева после поэлементной вставки известна: уровни из 1, 2, 3 и 3 узлов
+			Binary_Search_Tree<int, std::less<int>, std::allocator<int>, Tree_Stats> Tree = { 40,50,30,35,10,75,23,87,68 };
+			Tree_Shape_Stats shape = Tree.shape_stats();
+			Assert::AreEqual(size_t(4), shape.height, L"Неверная высота дерева");
+			Assert::IsTrue(shape.depth_histogram == std::vector<size_t>{ 1, 2, 3, 3 }, L"Неверная гистограмма глубин");
+			Assert::AreEqual(17.0 / 9, shape.average_depth, 1e-9, L"Неверная средняя глубина");
+			Assert::AreEqual(std::uint64_t(9), Tree.stats().allocations, L"Неверное число выделенных узлов");
+
+			Tree.reset_stats();
+			Tree.find(23);
+			Assert::IsTrue(Tree.stats().lookups == 1 && Tree.stats().visits == 4 && Tree.stats().comparisons == 4,
+				L"Неверная статистика поиска");
+			Tree.clear();
+			Assert::AreEqual(std::uint64_t(9), Tree.stats().frees, L"Неверное число освобождённых узлов");
+			Assert::AreEqual(size_t(0), Tree.shape_stats().height, L"Пустое дерево имеет ненулевую высоту");
+		}
+
+		TEST_METHOD(PmrAllocatorTest)
+		{
+			//  Узлы и строки должны размещаться в ресурсе дерева; без вышестоящего ресурса любая
+			//    попытка выделить память где-то ещё после исчерпания буфера завершится исключением
+			std::vector<char> Buffer(1 << 16);
+			std::pmr::monotonic_buffer_resource Pool(Buffer.data(), Buffer.size(), std::pmr::null_memory_resource());
+			pmr::Binary_Search_Tree<std::pmr::string> Tree({ "long string key number one", "long string key number two" }, &Pool);
+			Tree.insert(std::pmr::string("another long string key, not a small one"));
+			for (const auto& key : Tree)
+				Assert::IsTrue(key.get_allocator().resource() == &Pool, L"Ключ размещён не в ресурсе дерева");
+
+			std::pmr::monotonic_buffer_resource Other;
+			pmr::Binary_Search_Tree<std::pmr::string> Copy(Tree, &Other);
+			Assert::IsTrue(Copy == Tree && Copy.begin()->get_allocator().resource() == &Other, L"Ошибка копирования с аллокатором");
+
+			pmr::Binary_Search_Tree<std::pmr::string> Moved(std::move(Copy));
+			Assert::IsTrue(Moved.get_allocator().resource() == &Other && Moved.size() == 3 && Copy.empty(), L"Ошибка перемещения");
+
+			//  Полиморфный аллокатор не распространяется при присваивании – ключи копируются в свой ресурс
+			Tree = Moved;
+			Assert::IsTrue(Tree.get_allocator().resource() == &Pool && Tree.begin()->get_allocator().resource() == &Pool,
+				L"Аллокатор не должен меняться при присваивании");
+		}
+
+		TEST_METHOD(ForEachTest)
+		{
+			Binary_Search_Tree<int> Tree;
+			for (int i = 0; i < 1000; ++i)
+				Tree.insert((i * 7919) % 1000);
+			//  Вырожденная ветка глубже встроенной части стека обхода
+			for (int i = 1000; i < 1200; ++i)
+				Tree.insert(i);
+
+			std::vector<int> Visited;
+			Assert::IsTrue(Tree.for_each([&](int x) { Visited.push_back(x); }), L"Полный обход не должен прерываться");
+			Assert::IsTrue(std::equal(Visited.begin(), Visited.end(), Tree.begin(), Tree.end()), L"Неверный порядок полного обхода");
+
+			Visited.clear();
+			Tree.for_each_in_range(995, 1010, [&](int x) { Visited.push_back(x); });
+			Assert::IsTrue(std::equal(Visited.begin(), Visited.end(), Tree.lower_bound(995), Tree.lower_bound(1010)),
+				L"Неверный обход диапазона");
+			Visited.clear();
+			Tree.for_each_in_range(500, 500, [&](int x) { Visited.push_back(x); });
+			Assert::IsTrue(Visited.empty(), L"Пустой диапазон не должен обходиться");
+
+			int Count = 0;
+			Assert::IsFalse(Tree.for_each_in_range(100, 200, [&](int) { return ++Count < 10; }), L"Обход не остановлен");
+			Assert::AreEqual(10, Count, L"Обход остановлен не на том элементе");
+
+			//  Результат не типа bool не останавливает обход, даже когда он равен нулю
+			Binary_Search_Tree<int> Signed{ -1, 1, 2 };
+			int Sum = 0;
+			Assert::IsTrue(Signed.for_each([&](int x) { return Sum += x; }) && Sum == 2, L"Обход остановлен результатом не типа bool");
+		}
+
+		TEST_METHOD(ParallelTraversalTest)
+		{
+			Binary_Search_Tree<int> Tree;
+			for (int i = 0; i < 100000; ++i)
+				Tree.insert((i * 7919) % 100000);
+
+			auto Ranges = Tree.split_ranges(8);
+			Assert::AreEqual(size_t(8), Ranges.size(), L"Неверное число диапазонов");
+			Assert::IsTrue(Ranges.front().first == Tree.begin() && Ranges.back().second == Tree.end(), L"Диапазоны не покрывают дерево");
+			for (size_t i = 0; i < Ranges.size(); ++i) {
+				auto Length = std::distance(Ranges[i].first, Ranges[i].second);
+				//  Размеры частей оцениваются приблизительно, но ни одна не должна быть пустой или занимать почти всё дерево
+				Assert::IsTrue(Length > 0 && Length < 50000, L"Сильно неравномерное разбиение");
+				Assert::IsTrue(i == 0 || Ranges[i].first == Ranges[i - 1].second, L"Диапазоны идут не подряд");
+			}
+
+			std::atomic<long long> Sum{ 0 };
+			Tree.parallel_for_each([&](int x) { Sum += x; }, 4);
+			Assert::IsTrue(Sum == 99999LL * 100000 / 2, L"Неверная сумма параллельного обхода");
+
+			//  Объединение строк не коммутативно – проверяет порядок объединения частей
+			Binary_Search_Tree<int> Small = { 5, 3, 8, 1, 4, 7, 9, 2, 6 };
+			std::string Digits = Small.parallel_reduce(std::string(), [](std::string acc, int x) { return acc + char('0' + x); },
+				[](std::string a, std::string b) { return a + b; }, 3);
+			Assert::IsTrue(Digits == "123456789", L"Неверный порядок параллельной свёртки");
+
+			bool AllNonNegative = Tree.parallel_reduce(true, [](bool acc, int x) { return acc && x >= 0; },
+				[](bool a, bool b) { return a && b; }, 4);
+			Assert::IsTrue(AllNonNegative, L"Неверная логическая свёртка");
+		}
+
+		TEST_METHOD(IntervalTreeTest)
+		{
+			using I = Interval<int>;
+			Interval_Search_Tree<int> Tree = { {10, 20}, {5, 12}, {15, 30}, {1, 3}, {25, 26}, {18, 19}, {0, 100} };
+			Assert::IsTrue(Tree.containing(18) == std::vector<I>{ {0, 100}, {10, 20}, {15, 30}, {18, 19} }, L"Неверный поиск по точке");
+			Assert::IsTrue(Tree.containing(20) == std::vector<I>{ {0, 100}, {15, 30} }, L"Конец интервала не должен входить в него");
+			Assert::IsTrue(Tree.overlapping(3, 6) == std::vector<I>{ {0, 100}, {5, 12} }, L"Неверный поиск пересечений");
+
+			//  Максимальные концы должны пересчитываться при удалении – в том числе узла с двумя дочерними
+			Tree.erase(I{ 0, 100 });
+			Tree.erase(I{ 10, 20 });
+			Assert::IsTrue(Tree.containing(50).empty() && Tree.containing(11) == std::vector<I>{ {5, 12} }, L"Ошибка после удаления");
+
+			std::vector<int> Points = { 2, 11, 18, 25 };
+			std::vector<std::pair<int, I>> Found;
+			Tree.for_each_containing_sorted(Points.begin(), Points.end(), [&](int point, const I& interval) { Found.emplace_back(point, interval); });
+			Assert::IsTrue(Found == std::vector<std::pair<int, I>>{ {2, {1, 3}}, {11, {5, 12}}, {18, {15, 30}}, {25, {15, 30}}, {18, {18, 19}}, {25, {25, 26}} },
+				L"Неверный пакетный поиск");
+		}
+
+		TEST_METHOD(SearchMapTest)
+		{
+			Binary_Search_Map<std::string, int, std::less<>, std::allocator<std::pair<const std::string, int>>, Tree_Stats> Counts;
+			const char* Words[] = { "tree", "map", "tree", "node", "map", "tree" };
+			for (const char* word : Words)
+				++Counts[word];
+			Assert::IsTrue(Counts.size() == 3 && Counts.at("tree") == 3 && Counts.at("map") == 2, L"Неверные счётчики");
+
+			//  Повторное обновление существующего ключа – один спуск без выделения памяти
+			Counts.reset_stats();
+			++Counts["node"];
+			Assert::IsTrue(Counts.stats().lookups == 1 && Counts.stats().allocations == 0, L"Обновление значения не должно выделять память");
+
+			//  Поиск по const char* без создания std::string – компаратор прозрачный
+			auto it = Counts.find("map");
+			it->second = 10;
+			Assert::AreEqual(10, Counts.at("map"), L"Значение не изменилось через итератор");
+
+			Assert::IsFalse(Counts.try_emplace("node", 100).second, L"try_emplace не должен заменять значение");
+			Assert::IsFalse(Counts.insert_or_assign("node", 100).second, L"insert_or_assign должен заменить значение");
+			Assert::IsTrue(Counts.insert_or_assign("leaf", 1).second && Counts.at("node") == 100, L"Ошибка insert_or_assign");
+
+			std::vector<std::string> Keys;
+			for (const auto& [key, value] : Counts)
+				Keys.push_back(key);
+			Assert::IsTrue(Keys == std::vector<std::string>{ "leaf", "map", "node", "tree" }, L"Неверный порядок ключей");
+			Assert::AreEqual(size_t(1), Counts.erase("leaf"), L"Ошибка удаления по ключу");
+		}
+
+		TEST_METHOD(StaticSetTest)
+		{
+			//  Проверки на этапе компиляции – множество строится и просматривается в константных выражениях
+			static constexpr auto Keywords = make_static_set<std::string_view>({ "if", "else", "while", "for", "do", "return", "case" });
+			static_assert(Keywords.contains("while") && !Keywords.contains("goto"));
+			static_assert(*Keywords.begin() == "case" && *Keywords.lower_bound("f") == "for");
+
+			std::vector<std::string_view> Sorted(Keywords.begin(), Keywords.end());
+			Assert::IsTrue(Sorted == std::vector<std::string_view>{ "case", "do", "else", "for", "if", "return", "while" },
+				L"Неверный порядок обхода");
+			Assert::IsTrue(std::equal(Keywords.rbegin(), Keywords.rend(), Sorted.rbegin()), L"Неверный обратный обход");
+
+			std::string Probe = "return";
+			Assert::IsTrue(Keywords.find(Probe) != Keywords.end() && Keywords.upper_bound(Probe) == Keywords.find("while"),
+				L"Ошибка поиска во время выполнения");
+		}
+
+		TEST_METHOD(SmallTreeTest)
+		{
+			Small_Search_Tree<int, 4> Small{ 7, 3, 5 };
+			Assert::IsFalse(Small.spilled(), L"Малое множество не должно переходить к узлам");
+			Assert::IsTrue(Small.insert(1).second && !Small.insert(5).second && Small.size() == 4, L"Ошибка вставки в массив");
+
+			//  Переполнение массива: ключи переносятся в узлы дерева
+			Small.insert(9);
+			Assert::IsTrue(Small.spilled() && Small.size() == 5, L"Множество должно перейти к узлам при переполнении");
+			Assert::IsTrue(std::vector<int>(Small.begin(), Small.end()) == std::vector<int>{ 1, 3, 5, 7, 9 }, L"Неверный обход после переполнения");
+			Assert::IsTrue(*Small.lower_bound(4) == 5 && Small.erase(3) == 1 && !Small.contains(3), L"Ошибка поиска или удаления в дереве");
+
+			Small.clear();
+			Small.insert({ 2, 1 });
+			Assert::IsTrue(!Small.spilled() && *Small.begin() == 1 && *--Small.end() == 2, L"После очистки множество возвращается к массиву");
+
+			//  Обмен множеств в разных режимах: массив с деревом и массивы разной длины
+			Small_Search_Tree<int, 4> Large{ 10, 20, 30, 40, 50 }, Tiny{ 8 };
+			Small.swap(Large);
+			Assert::IsTrue(Small.spilled() && Small.size() == 5 && !Large.spilled() && Large.size() == 2 && *Large.begin() == 1,
+				L"Ошибка обмена массива с деревом");
+			Large.swap(Tiny);
+			Assert::IsTrue(Large.size() == 1 && *Large.begin() == 8 && Tiny.size() == 2 && *--Tiny.end() == 2, L"Ошибка обмена массивов");
+			Small.swap(Tiny);
+			Assert::IsTrue(!Small.spilled() && Small.size() == 2 && Tiny.spilled() && *--Tiny.end() == 50, L"Ошибка обмена дерева с массивом");
+
+			//  Исключение при переполнении массива оставляет множество прежним
+			Small_Search_Tree<FragileKey, 4> Fragile;
+			for (int i : { 4, 3, 2, 1 })
+				Fragile.insert(FragileKey(i));
+			FragileKey::copies_left = 6;
+			bool thrown = false;
+			try {
+				Fragile.insert(FragileKey(5));
+			}
+			catch (const std::runtime_error&) {
+				thrown = true;
+			}
+			FragileKey::copies_left = -1;
+			std::vector<int> values;
+			for (const auto& key : Fragile)
+				values.push_back(key.value);
+			Assert::IsTrue(thrown && !Fragile.spilled() && values == std::vector<int>{ 1, 2, 3, 4 }, L"Неудачное переполнение изменило множество");
+		}
+
+		TEST_METHOD(AppendTest)
+		{
+			//  Возрастающие ключи: дерево не вырождается в список, глубина остаётся логарифмической
+			Binary_Search_Tree<int> Tree;
+			for (int i = 0; i < 1023; ++i)
+				Tree.append(i);
+			Assert::IsTrue(Tree.size() == 1023 && Tree.CheckTree(), L"Ошибка добавления в конец");
+			Assert::IsTrue(Tree.shape_stats().height <= 20, L"Дерево из добавлений в конец должно быть сбалансированным");
+
+			//  Ключ не больше максимума вставляется обычным образом, повтор не вставляется
+			Assert::IsTrue(Tree.append(-1).second && !Tree.append(500).second, L"Ошибка вставки не в конец");
+			std::vector<int> Batch{ 1023, 1024, 1024, 2000 };
+			Tree.append(Batch.begin(), Batch.end());
+			Assert::IsTrue(Tree.size() == 1027 && *--Tree.end() == 2000 && *Tree.begin() == -1, L"Ошибка добавления пачки");
+		}
+
+		TEST_METHOD(MerkleDiffTest)
+		{
+			//  Одинаковые ключи, разная форма: хэши совпадают
+			Merkle_Search_Tree<int> Here, There;
+			for (int i = 0; i < 1000; ++i) {
+				Here.insert((i * 7919) % 1000);
+				There.append(i);
+			}
+			Assert::IsTrue(Here.summary() == There.summary() && Here.diff(There).empty(), L"Хэши одинаковых множеств должны совпадать");
+
+			Here.erase(10);
+			There.insert(2000);
+			auto Diff = Here.diff(There);
+			Assert::IsTrue(Diff.only_here.empty() && Diff.only_there == std::vector<int>{ 10, 2000 }, L"Ошибка поиска различий");
+
+			//  Сверка через поток, как между процессами
+			Tree_Diff<int> HereDiff, ThereDiff;
+			Merkle_Digest<int> Message = Here.digest();
+			for (bool ThereTurn = true; !Message.empty(); ThereTurn = !ThereTurn) {
+				std::stringstream Pipe;
+				Message.write(Pipe);
+				Merkle_Digest<int> Received;
+				Assert::IsTrue(Received.read(Pipe), L"Ошибка чтения списка диапазонов");
+				Message = ThereTurn ? There.reconcile(Received, ThereDiff) : Here.reconcile(Received, HereDiff);
+			}
+			std::sort(HereDiff.only_there.begin(), HereDiff.only_there.end());
+			Assert::IsTrue(HereDiff.only_here.empty() && HereDiff.only_there == Diff.only_there && ThereDiff.only_here.size() == 2,
+				L"Ошибка сверки через поток");
+		}
+
+		TEST_METHOD(RebalanceTest)
+		{
+			//  Вставка по возрастанию вытягивает дерево в цепочку
+			Binary_Search_Tree<int, std::less<int>, std::allocator<int>, Tree_Stats> Tree;
+			for (int i = 0; i < 1000; ++i)
+				Tree.insert(i);
+			auto First = Tree.begin();
+			Tree.reset_stats();
+			Tree_Rebalance_Stats Result = Tree.rebalance();
+			Assert::IsTrue(Result.height_before == 1000 && Result.height_after == 10 && Tree.height() == 10, L"Неверная высота после перестройки");
+			Assert::IsTrue(Tree.CheckTree() && Tree.size() == 1000 && *First == 0 && *--Tree.end() == 999, L"Перестройка нарушила дерево");
+			Assert::IsTrue(Tree.stats().allocations == 0 && Tree.stats().frees == 0, L"Перестройка не должна выделять узлы");
+		}
+
+		TEST_METHOD(OptimizeTest)
+		{
+			Binary_Search_Tree<int> Tree;
+			for (int i = 0; i < 1000; ++i)
+				Tree.insert((i * 7919) % 1000);
+			//  Обращения только к ключам, кратным 100
+			auto Weight = [](int key) { return key % 100 == 0 ? 1.0 : 0.0; };
+			double Before = Tree.expected_depth(Weight);
+			Tree.optimize(Weight);
+			Assert::IsTrue(Tree.expected_depth(Weight) < Before && Tree.expected_depth(Weight) <= 4, L"Частые ключи должны оказаться близко к корню");
+			Assert::IsTrue(Tree.CheckTree() && Tree.size() == 1000 && *Tree.begin() == 0 && *--Tree.end() == 999, L"Перестройка нарушила дерево");
+		}
+
+		TEST_METHOD(PriorityQueueTest)
+		{
+			Binary_Search_Tree<int, std::less<int>, std::allocator<int>, Tree_Stats> Timers{ 50, 10, 30, 20, 40 };
+			Assert::IsTrue(Timers.top_min() == 10 && Timers.top_max() == 50, L"Неверные минимум или максимум");
+			Timers.pop_min();
+			Timers.pop_max();
+			Assert::IsTrue(Timers.top_min() == 20 && Timers.top_max() == 40 && Timers.size() == 3 && Timers.CheckTree(), L"Ошибка извлечения");
+
+			//  Перенос таймера: узел не перевыделяется, итератор остаётся действительным
+			Timers.reset_stats();
+			auto Timer = Timers.find(20);
+			auto Result = Timers.update_key(Timer, 45);
+			Assert::IsTrue(Result.second && Result.first == Timer && Timers.top_min() == 30 && Timers.top_max() == 45, L"Ошибка изменения ключа");
+			Assert::IsTrue(Timers.stats().allocations == 0 && Timers.stats().frees == 0 && Timers.CheckTree(), L"Изменение ключа не должно выделять узлы");
+			Assert::IsFalse(Timers.update_key(Timers.find(30), 40).second, L"Ключ, который уже есть, не должен устанавливаться");
+		}
 	};
 	
-	TEST_CLASS(SetTests)
+	//  Тела тестов множества, общие для всех контейнеров с интерфейсом std::set: Mycont – проверяемый контейнер символов
+	template<class Mycont>
+	struct Set_Test_Cases
 	{
-		//  Тесты стандартного контейнера std::set, из книги "The C++ Standard template library" Плаугера, Степанова и др.
-	public:
-
-		using Myal = std::allocator<char>;
-		using Mypred = std::less<char>;
-		
-		//  Для того, чтобы выполнить тестирование одного из указанных контейнеров (std::set или Binary_Tree_Search)
-		//    должна быть раскомментирована одна из следующих строк:
-		//template<typename T> using ContainerTemplate = std::set<T, Mypred, Myal>;
-		template<typename T> using ContainerTemplate = Binary_Search_Tree<T, Mypred, Myal>;
+		using Myal = typename Mycont::allocator_type;
+		using Mypred = typename Mycont::key_compare;
 
-		using Mycont = ContainerTemplate<char>;
-
-		TEST_METHOD(SetSize)
+		static void Size()
 		{
 			Mycont v0;
 			Myal al = v0.get_allocator();
@@ -82,13 +572,12 @@ namespace TreeTest
 			Assert::IsTrue(v0b.size() == 0 && v0b.get_allocator() == al, L"Неверный размер или аллокатор");
 		}
 
-		TEST_METHOD(SetCreation)
+		static void Creation()
 		{
-			char carr[] = "abc", carr2[] = "def";
+			char carr[] = "abc";
 			Mycont v0;
 			Myal al = v0.get_allocator();
 			Mypred pred;
-			Mycont v0a(pred);
 
 			Mycont v1(carr, carr + 3);
 			Assert::IsTrue(v1.size() == 3 && *v1.begin() == 'a', L"Неверно создаётся set символов");
@@ -101,55 +590,32 @@ namespace TreeTest
 
 			const Mycont v4(carr, carr + 3);
 			v0 = v4;
-			Assert::IsTrue(v1.size() == 3 && *v1.begin() == 'a', L"Неверно работает оператор присваивания для set");
+			Assert::IsTrue(v0.size() == 3 && *v0.begin() == 'a', L"Неверно работает оператор присваивания для set");
 		}
 
-		TEST_METHOD(SetIterators)
+		static void Iterators()
 		{
-			char ch('a'), carr[] = "abc", carr2[] = "def";
-			Mycont v0;
-			Myal al = v0.get_allocator();
-			Mypred pred;
-			Mycont v0a(pred);
-
+			char carr[] = "abc";
 			Mycont v1(carr, carr + 3);
-			Mycont v2(carr, carr + 3, pred);
-			Mycont v3(carr, carr + 3, pred, al);
 			const Mycont v4(carr, carr + 3);
-			v0 = v4;
 
-			Mycont::iterator p_it(v1.begin());
-			Mycont::const_iterator p_cit(v4.begin());
-			Mycont::reverse_iterator p_rit(v1.rbegin());
-			Mycont::const_reverse_iterator p_crit(v4.rbegin());
+			typename Mycont::iterator p_it(v1.begin());
+			typename Mycont::const_iterator p_cit(v4.begin());
+			typename Mycont::reverse_iterator p_rit(v1.rbegin());
+			typename Mycont::const_reverse_iterator p_crit(v4.rbegin());
 
-			/*Assert::IsTrue(*p_it == 'a' && *--(p_it = v1.end()) == 'c', L"Декремент end() не корректен?");
+			Assert::IsTrue(*p_it == 'a' && *--(p_it = v1.end()) == 'c', L"Декремент end() не корректен?");
 			Assert::IsTrue(*p_cit == 'a' && *--(p_cit = v4.end()) == 'c', L"Декремент для const iterator на end() не корректен?");
-			//Assert::IsTrue(*p_rit == 'c' && *--(p_rit = v1.rend()) == 'a', L"Reverse iterator не корректен?");
-			Assert::IsTrue(*p_crit == 'c' && *--(p_crit = v4.rend()) == 'a', L"Const reverse iterator не корректен?");*/
+			Assert::IsTrue(*p_rit == 'c' && *--(p_rit = v1.rend()) == 'a', L"Reverse iterator не корректен?");
+			Assert::IsTrue(*p_crit == 'c' && *--(p_crit = v4.rend()) == 'a', L"Const reverse iterator не корректен?");
 		}
 
-		TEST_METHOD(SetInsertEraseTests)
+		static void InsertErase()
 		{
 			char carr[] = "abc", carr2[] = "def";
 			Mycont v0;
-			Myal al = v0.get_allocator();
-			Mypred pred;
-			Mycont v0a(pred);
-
-			Mycont v1(carr, carr + 3);
-			Mycont v2(carr, carr + 3, pred);
-			Mycont v3(carr, carr + 3, pred, al);
-			const Mycont v4(carr, carr + 3);
-			v0 = v4;
-
-			Mycont::iterator p_it(v1.begin());
-			Mycont::const_iterator p_cit(v4.begin());
-			Mycont::reverse_iterator p_rit(v1.rbegin());
-			Mycont::const_reverse_iterator p_crit(v4.rbegin());
 
-			v0.clear();
-			std::pair<Mycont::iterator, bool> pib = v0.insert('d');
+			std::pair<typename Mycont::iterator, bool> pib = v0.insert('d');
 			Assert::IsTrue(*pib.first == 'd' && pib.second);
 			Assert::IsTrue(*--v0.end() == 'd');
 			pib = v0.insert('d');
@@ -164,15 +630,14 @@ namespace TreeTest
 			Assert::IsTrue(v0.erase('x') == 0 && v0.erase('e') == 1);
 		}
 
-		TEST_METHOD(SetSwapAndCompTests)
+		static void SwapAndComp()
 		{
 			char carr[] = "abc", carr2[] = "def";
 			Mycont v0;
 			Mycont v1(carr, carr + 3);
 
-			v0.clear();
-			std::pair<Mycont::iterator, bool> pib = v0.insert('d');
-			pib = v0.insert('d');
+			v0.insert('d');
+			v0.insert('d');
 			v0.insert(v0.begin(), 'e');
 			v0.insert(carr, carr + 3);
 			v0.insert(carr2, carr2 + 3);
@@ -191,27 +656,86 @@ namespace TreeTest
 			Assert::IsTrue(v0 <= v1 && v1 >= v0, L"Сравнение множеств некорректно!");
 		}
 
-		TEST_METHOD(SetComparatorTests)
+		static void Comparator()
 		{
 			Mycont v0;
 			Assert::IsTrue(v0.key_comp()('a', 'c') && !v0.key_comp()('a', 'a'), L"Некорректный компаратор!");
 			Assert::IsTrue(v0.value_comp()('a', 'c') && !v0.value_comp()('a', 'a'), L"Некорректный компаратор!");
 		}
 
-		TEST_METHOD(SetAlgTests)
+		static void Alg()
 		{
 			char carr[] = "abc";
-			const Mycont v4(carr, carr+3);
+			const Mycont v4(carr, carr + 3);
 
 			Assert::IsTrue(*v4.find('b') == 'b');
 			Assert::IsTrue(v4.count('x') == 0 && v4.count('b') == 1);
 			Assert::IsTrue(*v4.lower_bound('a') == 'a', L"Метод lower_bound");
 			Assert::IsTrue(*v4.upper_bound('a') == 'b', L"Метод upper_bound");
-			std::pair<Mycont::const_iterator, Mycont::const_iterator> pcc = v4.equal_range('a');
+			std::pair<typename Mycont::const_iterator, typename Mycont::const_iterator> pcc = v4.equal_range('a');
 			Assert::IsTrue(*pcc.first == 'a' && *pcc.second == 'b', L"Ошибка метода equal_range");
 		}
 	};
 
+	TEST_CLASS(SetTests)
+	{
+		//  Тесты стандартного контейнера std::set, из книги "The C++ Standard template library" Плаугера, Степанова и др.
+	public:
+
+		using Myal = std::allocator<char>;
+		using Mypred = std::less<char>;
+		
+		//  Для того, чтобы выполнить тестирование одного из указанных контейнеров (std::set или Binary_Tree_Search)
+		//    должна быть раскомментирована одна из следующих строк:
+		//template<typename T> using ContainerTemplate = std::set<T, Mypred, Myal>;
+		template<typename T> using ContainerTemplate = Binary_Search_Tree<T, Mypred, Myal>;
+
+		using Mycont = ContainerTemplate<char>;
+		using Cases = Set_Test_Cases<Mycont>;
+
+		TEST_METHOD(SetSize) { Cases::Size(); }
+		TEST_METHOD(SetCreation) { Cases::Creation(); }
+		TEST_METHOD(SetIterators) { Cases::Iterators(); }
+		TEST_METHOD(SetInsertEraseTests) { Cases::InsertErase(); }
+		TEST_METHOD(SetSwapAndCompTests) { Cases::SwapAndComp(); }
+		TEST_METHOD(SetComparatorTests) { Cases::Comparator(); }
+		TEST_METHOD(SetAlgTests) { Cases::Alg(); }
+	};
+
+	TEST_CLASS(FlatSetTests)
+	{
+		//  Те же тесты для множества на отсортированном массиве
+	public:
+
+		using Myal = std::allocator<char>;
+		using Mypred = std::less<char>;
+		
+		template<typename T> using ContainerTemplate = Flat_Search_Tree<T, Mypred, Myal>;
+
+		using Mycont = ContainerTemplate<char>;
+		using Cases = Set_Test_Cases<Mycont>;
+
+		TEST_METHOD(FlatSetSize) { Cases::Size(); }
+		TEST_METHOD(FlatSetCreation) { Cases::Creation(); }
+		TEST_METHOD(FlatSetIterators) { Cases::Iterators(); }
+		TEST_METHOD(FlatSetInsertEraseTests) { Cases::InsertErase(); }
+		TEST_METHOD(FlatSetSwapAndCompTests) { Cases::SwapAndComp(); }
+		TEST_METHOD(FlatSetComparatorTests) { Cases::Comparator(); }
+		TEST_METHOD(FlatSetAlgTests) { Cases::Alg(); }
+
+		TEST_METHOD(FlatConversionTests)
+		{
+			char carr[] = "dacb", carr2[] = "def";
+			Binary_Search_Tree<char, Mypred, Myal> tree(carr, carr + 4);
+			Mycont v0(tree);
+			Assert::IsTrue(v0.size() == 4 && *v0.begin() == 'a' && *--v0.end() == 'd', L"Ошибка преобразования из дерева");
+			v0.insert(carr2, carr2 + 3);
+			auto tree2 = v0.to_tree();
+			Assert::IsTrue(tree2.size() == 6 && tree2.CheckTree() && std::equal(tree2.begin(), tree2.end(), v0.begin()),
+				L"Ошибка преобразования в дерево");
+		}
+	};
+
 	TEST_CLASS(MultiSetTests)
 	{
 		///  Тесты стандартного контейнера std::multiset, из книги "The C++ Standard template library" Плаугера, Степанова и др.
@@ -387,4 +911,203 @@ namespace TreeTest
 		}
 	};
 
+	TEST_CLASS(FlatCombiningTests)
+	{
+		//  Тесты обёртки Flat_Combining_Tree – конкурентная вставка из нескольких потоков
+	public:
+
+		TEST_METHOD(ConcurrentInsert)
+		{
+			Flat_Combining_Tree<int> tree(4);
+			std::vector<std::thread> writers;
+			for (int k = 0; k < 4; ++k)
+				writers.emplace_back([&tree, k]() {
+					for (int i = 0; i < 1000; ++i)
+						tree.insert(i * 4 + k % 2);
+				});
+			for (auto& w : writers)
+				w.join();
+
+			Assert::IsTrue(tree.size() == 2000, L"Неверный размер после конкурентной вставки");
+			Assert::IsTrue(tree.contains(4) && tree.contains(5) && !tree.contains(6), L"Ошибка поиска в Flat_Combining_Tree");
+			Assert::IsTrue(tree.erase(4) && !tree.contains(4), L"Ошибка удаления в Flat_Combining_Tree");
+			bool sorted = tree.apply([](const Flat_Combining_Tree<int>::tree_type& t) {
+				return std::is_sorted(t.begin(), t.end()) && t.CheckTree();
+			});
+			Assert::IsTrue(sorted, L"Дерево после пакетного применения операций некорректно");
+		}
+
+		//  Компаратор, бросающий исключение при любом сравнении с ключом 13
+		struct ThrowingCompare
+		{
+			bool operator()(int a, int b) const
+			{
+				if (a == 13 || b == 13) throw std::runtime_error("unlucky key");
+				return a < b;
+			}
+		};
+
+		TEST_METHOD(OperationException)
+		{
+			//  Исключение получает только поток, чья операция его вызвала; остальные не зависают
+			Flat_Combining_Tree<int, ThrowingCompare> tree(4);
+			std::atomic<int> failures{ 0 };
+			std::vector<std::thread> writers;
+			for (int k = 0; k < 4; ++k)
+				writers.emplace_back([&tree, &failures, k]() {
+					for (int i = k; i < 400; i += 4) {
+						try {
+							tree.insert(i);
+						}
+						catch (const std::runtime_error&) {
+							++failures;
+						}
+					}
+				});
+			for (auto& w : writers)
+				w.join();
+
+			Assert::AreEqual(1, failures.load(), L"Исключение должно получить ровно одна операция");
+			Assert::IsTrue(tree.size() == 399 && tree.contains(12) && tree.erase(14), L"Ошибка операций после исключения");
+		}
+	};
+
+	TEST_CLASS(SnapshotTests)
+	{
+		//  Тесты двоичных снимков дерева: сохранение, загрузка и отображение в память
+	public:
+
+		TEST_METHOD(SaveLoadTest)
+		{
+			std::string path = (std::filesystem::temp_directory_path() / "bstree_snapshot_test.bin").string();
+			Binary_Search_Tree<int> Tree = { 40,50,30,35,10,75,23,87,68 };
+			Assert::IsTrue(Tree.save(path), L"Не удалось записать снимок");
+
+			Binary_Search_Tree<int> Loaded = { 1, 2 };
+			Assert::IsTrue(Loaded.load(path), L"Не удалось прочитать снимок");
+			Assert::IsTrue(Loaded == Tree && Loaded.size() == Tree.size() && Loaded.CheckTree(), L"Загруженное дерево отличается от сохранённого");
+
+			//  С сохранённой формой дерево восстанавливается в точности – повторный снимок совпадает побайтно
+			std::string shaped_path = path + ".shape";
+			Assert::IsTrue(Tree.save(shaped_path, true) && Loaded.load(shaped_path) && Loaded.save(path, true), L"Ошибка снимка с формой дерева");
+			std::ifstream first(shaped_path, std::ios::binary), second(path, std::ios::binary);
+			Assert::IsTrue(std::equal(std::istreambuf_iterator<char>(first), std::istreambuf_iterator<char>(),
+				std::istreambuf_iterator<char>(second), std::istreambuf_iterator<char>()), L"Форма дерева не восстановлена");
+			first.close();
+			second.close();
+
+			//  Обрезанный снимок и снимок с огромным числом ключей в заголовке отвергаются без выделения памяти под ключи
+			std::filesystem::resize_file(shaped_path, Tree_Snapshot_Header::keys_offset + 3 * sizeof(int));
+			Assert::IsFalse(Loaded.load(shaped_path), L"Обрезанный снимок не должен загружаться");
+			{
+				std::fstream corrupt(path, std::ios::binary | std::ios::in | std::ios::out);
+				std::uint64_t huge = ~std::uint64_t(0) / 2;
+				corrupt.seekp(offsetof(Tree_Snapshot_Header, count));
+				corrupt.write(reinterpret_cast<const char*>(&huge), sizeof(huge));
+			}
+			Assert::IsTrue(!Loaded.load(path) && Loaded.empty(), L"Снимок с неверным числом ключей не должен загружаться");
+			std::filesystem::remove(shaped_path);
+			std::filesystem::remove(path);
+		}
+
+		TEST_METHOD(MappedTreeTest)
+		{
+			std::string path = (std::filesystem::temp_directory_path() / "bstree_mapped_test.bin").string();
+			Binary_Search_Tree<int> Tree = { 40,50,30,35,10,75,23,87,68 };
+			Assert::IsTrue(Tree.save(path), L"Не удалось записать снимок");
+			{
+				Mapped_Search_Tree<int> Mapped(path);
+				Assert::IsTrue(Mapped.is_open() && Mapped.size() == Tree.size(), L"Снимок не отображён в память");
+				Assert::IsTrue(std::equal(Mapped.begin(), Mapped.end(), Tree.begin(), Tree.end()), L"Содержимое отображения отличается от дерева");
+				Assert::IsTrue(*Mapped.find(35) == 35 && Mapped.find(36) == Mapped.end(), L"Метод find");
+				Assert::IsTrue(*Mapped.lower_bound(36) == 40 && *Mapped.upper_bound(40) == 50, L"Методы lower_bound/upper_bound");
+			}
+			std::filesystem::remove(path);
+			Mapped_Search_Tree<int> Missing(path);
+			Assert::IsTrue(!Missing.is_open(), L"Отсутствующий файл не должен открываться");
+		}
+
+		TEST_METHOD(DurableRecoveryTest)
+		{
+			std::string base = (std::filesystem::temp_directory_path() / "bstree_durable_test").string();
+			std::filesystem::remove(base + ".snap");
+			std::filesystem::remove(base + ".log");
+			{
+				Durable_Search_Tree<int> Tree(4);
+				Assert::IsTrue(Tree.open(base), L"Не удалось открыть журнал");
+				for (int i = 0; i < 10; ++i)
+					Tree.insert(i);
+				Tree.erase(3);
+				Assert::IsTrue(Tree.compact(), L"Ошибка уплотнения журнала");
+				Tree.insert(100);
+				Tree.erase(5);
+				Assert::IsTrue(Tree.commit(), L"Ошибка записи журнала");
+			}
+			//  Недописанная пачка в конце журнала должна быть отброшена при восстановлении
+			{
+				std::ofstream tail(base + ".log", std::ios::binary | std::ios::app);
+				tail << "BSTL\x05";
+			}
+			Durable_Search_Tree<int> Recovered;
+			Assert::IsTrue(Recovered.open(base), L"Не удалось восстановить дерево");
+			Assert::IsTrue(Recovered.size() == 9 && Recovered.contains(100) && !Recovered.contains(3) && !Recovered.contains(5),
+				L"Восстановленное дерево отличается от сохранённого");
+			Recovered.close();
+
+			//  Заголовок повреждённой пачки с огромным числом записей не должен приводить к выделению памяти под них
+			{
+				std::ofstream tail(base + ".log", std::ios::binary | std::ios::app);
+				tail << "BSTL";
+				tail.write("\xff\xff\xff\xff\0\0\0\0\0\0\0\0", 12);
+				tail << "torn";
+			}
+			Assert::IsTrue(Recovered.open(base) && Recovered.size() == 9, L"Повреждённая пачка не отброшена");
+			Recovered.close();
+			std::filesystem::remove(base + ".snap");
+			std::filesystem::remove(base + ".log");
+		}
+
+		TEST_METHOD(PagedTreeTest)
+		{
+			std::string path = (std::filesystem::temp_directory_path() / "bstree_paged_test.bin").string();
+			std::set<int> Etalon;
+			{
+				//  Пул из 16 страниц заведомо меньше дерева – страницы постоянно вытесняются и читаются заново
+				Paged_Search_Tree<int> Tree(16 * 4096);
+				Assert::IsTrue(Tree.open(path, true), L"Не удалось создать файл дерева");
+				for (int i = 0; i < 100000; ++i) {
+					int value = (i * 7919) % 150000;
+					Assert::IsTrue(Tree.insert(value).second == Etalon.insert(value).second, L"Неверный результат вставки");
+				}
+				for (int i = 0; i < 150000; i += 3)
+					Assert::IsTrue(Tree.erase(i) == Etalon.erase(i), L"Неверный результат удаления");
+				Assert::IsTrue(Tree.pool_stats().misses > Tree.pool_stats().frames, L"Дерево поместилось в буферный пул");
+			}
+			Paged_Search_Tree<int> Tree(16 * 4096);
+			Assert::IsTrue(Tree.open(path), L"Не удалось открыть файл дерева");
+			Assert::AreEqual(Etalon.size(), Tree.size(), L"Неверный размер после повторного открытия");
+			Assert::IsTrue(std::equal(Tree.begin(), Tree.end(), Etalon.begin(), Etalon.end()), L"Неверный порядок элементов");
+			Assert::IsTrue(*Tree.lower_bound(3) == *Etalon.lower_bound(3) && *Tree.upper_bound(4) == *Etalon.upper_bound(4),
+				L"Неверные границы");
+			Assert::IsTrue(Tree.find(3) == Tree.end() && Tree.count(7919) == 1, L"Неверный поиск");
+			Assert::AreEqual(*Etalon.rbegin(), *--Tree.end(), L"Неверный последний элемент");
+			Assert::IsTrue(Tree.close(), L"Ошибка записи при закрытии файла дерева");
+
+			//  Страницы обрезанного файла не читаются как пустые: обход должен закончиться исключением
+			std::filesystem::resize_file(path, std::filesystem::file_size(path) / 2);
+			Assert::IsTrue(Tree.open(path), L"Не удалось открыть обрезанный файл дерева");
+			bool thrown = false;
+			try {
+				std::size_t visited = std::distance(Tree.begin(), Tree.end());
+				(void)visited;
+			}
+			catch (const std::runtime_error&) {
+				thrown = true;
+			}
+			Assert::IsTrue(thrown, L"Чтение отсутствующей страницы должно бросать исключение");
+			Tree.close();
+			std::filesystem::remove(path);
+		}
+	};
+
 }
\ No newline at end of file